@@ -29,96 +29,152 @@
  * Manipulate command arguments.
  */
 
-struct args_entry	*args_find(struct args *, u_char);
+#define args_bit(ch)	(1 << ((ch) & 7))
 
-RB_GENERATE(args_tree, args_entry, entry, args_cmp);
+static int		 args_find(struct args *, u_char);
+static struct args	*args_copy(struct args *, int, char **);
 
-/* Arguments tree comparison function. */
-int
-args_cmp(struct args_entry *a1, struct args_entry *a2)
+/* Find the value slot of a flag, or -1 if it has none. */
+static int
+args_find(struct args *args, u_char ch)
 {
-	return (a1->flag - a2->flag);
+	u_int	i;
+
+	for (i = 0; i < args->nvalues; i++) {
+		if (args->value_flag[i] == ch)
+			return (i);
+	}
+	return (-1);
 }
 
-/* Create an arguments set with no flags. */
-struct args *
-args_create(int argc, ...)
+/*
+ * Make an arguments set from a template holding the flags, copying the
+ * values and argv into the same allocation.
+ */
+static struct args *
+args_copy(struct args *template, int argc, char **argv)
 {
 	struct args	*args;
-	va_list		 ap;
-	int		 i;
+	size_t		 size, n;
+	char		*ptr;
+	u_int		 i;
+	int		 j;
 
-	args = xcalloc(1, sizeof *args);
+	size = sizeof *args + argc * sizeof *args->argv;
+	for (i = 0; i < template->nvalues; i++)
+		size += strlen(template->value[i]) + 1;
+	for (j = 0; j < argc; j++)
+		size += strlen(argv[j]) + 1;
+
+	args = xmalloc(size);
+	memcpy(args, template, sizeof *args);
 
 	args->argc = argc;
 	if (argc == 0)
 		args->argv = NULL;
 	else
-		args->argv = xcalloc(argc, sizeof *args->argv);
+		args->argv = (char **)(args + 1);
+	ptr = (char *)(args + 1) + argc * sizeof *args->argv;
 
-	va_start(ap, argc);
-	for (i = 0; i < argc; i++)
-		args->argv[i] = xstrdup(va_arg(ap, char *));
-	va_end(ap);
+	for (i = 0; i < args->nvalues; i++) {
+		n = strlen(template->value[i]) + 1;
+		args->value[i] = memcpy(ptr, template->value[i], n);
+		ptr += n;
+	}
+	for (j = 0; j < argc; j++) {
+		n = strlen(argv[j]) + 1;
+		args->argv[j] = memcpy(ptr, argv[j], n);
+		ptr += n;
+	}
 
 	return (args);
 }
 
-/* Find a flag in the arguments tree. */
-struct args_entry *
-args_find(struct args *args, u_char ch)
+/* Count the flags in a template which take a value. */
+u_int
+args_template_values(const char *template)
+{
+	u_int	n = 0;
+
+	for (; *template != '\0'; template++) {
+		if (template[1] == ':')
+			n++;
+	}
+	return (n);
+}
+
+/* Create an arguments set with no flags. */
+struct args *
+args_create(int argc, ...)
 {
-	struct args_entry	entry;
+	struct args	 template, *args;
+	char		**argv;
+	va_list		 ap;
+	int		 i;
 
-	entry.flag = ch;
-	return (RB_FIND(args_tree, &args->tree, &entry));
+	memset(&template, 0, sizeof template);
+
+	argv = xcalloc(argc == 0 ? 1 : argc, sizeof *argv);
+	va_start(ap, argc);
+	for (i = 0; i < argc; i++)
+		argv[i] = va_arg(ap, char *);
+	va_end(ap);
+
+	args = args_copy(&template, argc, argv);
+	free(argv);
+
+	return (args);
 }
 
-/* Parse an argv and argc into a new argument set. */
+/*
+ * Parse an argv and argc into a new argument set.  The flags are collected
+ * on the stack first so the set is only allocated once it is known to be
+ * valid.
+ */
 struct args *
 args_parse(const char *template, int argc, char **argv)
 {
-	struct args	*args;
+	struct args	 args;
 	char		*ptr;
-	int		 opt;
+	int		 opt, i;
+	u_char		 ch;
 
-	args = xcalloc(1, sizeof *args);
+	memset(&args, 0, sizeof args);
 
 	optind = 1;
 
 	while ((opt = getopt(argc, argv, template)) != -1) {
 		if (opt < 0)
 			continue;
-		if (opt == '?' || (ptr = strchr(template, opt)) == NULL) {
-			args_free(args);
+		if (opt == '?' || (ptr = strchr(template, opt)) == NULL)
 			return (NULL);
+		ch = opt;
+
+		args.flags[ch >> 3] |= args_bit(ch);
+		if (ptr[1] != ':')
+			continue;
+
+		/* Templates are checked when commands are first looked up,
+		 * so running out of slots here shouldn't happen.
+		 */
+		if ((i = args_find(&args, ch)) == -1) {
+			if (args.nvalues == ARGS_VALUES)
+				return (NULL);
+			i = args.nvalues++;
+			args.value_flag[i] = ch;
 		}
-		args_set(args, opt, optarg);
+		args.value[i] = optarg;
 	}
 	argc -= optind;
 	argv += optind;
 
-	args->argc = argc;
-	args->argv = cmd_copy_argv(argc, argv);
-
-	return (args);
+	return (args_copy(&args, argc, argv));
 }
 
 /* Free an arguments set. */
 void
 args_free(struct args *args)
 {
-	struct args_entry	*entry;
-	struct args_entry	*entry1;
-
-	cmd_free_argv(args->argc, args->argv);
-
-	RB_FOREACH_SAFE(entry, args_tree, &args->tree, entry1) {
-		RB_REMOVE(args_tree, &args->tree, entry);
-		free(entry->value);
-		free(entry);
-	}
-
 	free(args);
 }
 
@@ -127,9 +183,8 @@ size_t
 args_print(struct args *args, char *buf, size_t len)
 {
 	size_t		 	 off;
-	int			 i;
-	const char		*quotes;
-	struct args_entry	*entry;
+	int			 i, ch;
+	const char		*quotes, *value;
 
 	/* There must be at least one byte at the start. */
 	if (len == 0)
@@ -138,37 +193,37 @@ args_print(struct args *args, char *buf, size_t len)
 
 	/* Process the flags first. */
 	buf[off++] = '-';
-	RB_FOREACH(entry, args_tree, &args->tree) {
-		if (entry->value != NULL)
+	for (ch = 0; ch < 256; ch++) {
+		if (!args_has(args, ch) || args_find(args, ch) != -1)
 			continue;
 
 		if (off == len - 1) {
 			buf[off] = '\0';
 			return (len);
 		}
-		buf[off++] = entry->flag;
+		buf[off++] = ch;
 		buf[off] = '\0';
 	}
 	if (off == 1)
 		buf[--off] = '\0';
 
 	/* Then the flags with arguments. */
-	RB_FOREACH(entry, args_tree, &args->tree) {
-		if (entry->value == NULL)
+	for (ch = 0; ch < 256; ch++) {
+		if ((i = args_find(args, ch)) == -1)
 			continue;
+		value = args->value[i];
 
 		if (off >= len) {
 			/* snprintf will have zero terminated. */
 			return (len);
 		}
 
-		if (strchr(entry->value, ' ') != NULL)
+		if (strchr(value, ' ') != NULL)
 			quotes = "\"";
 		else
 			quotes = "";
 		off += snprintf(buf + off, len - off, "%s-%c %s%s%s",
-		    off != 0 ? " " : "", entry->flag, quotes, entry->value,
-		    quotes);
+		    off != 0 ? " " : "", ch, quotes, value, quotes);
 	}
 
 	/* And finally the argument vector. */
@@ -193,42 +248,18 @@ args_print(struct args *args, char *buf, size_t len)
 int
 args_has(struct args *args, u_char ch)
 {
-	return (args_find(args, ch) == NULL ? 0 : 1);
-}
-
-/* Set argument value in the arguments tree. */
-void
-args_set(struct args *args, u_char ch, const char *value)
-{
-	struct args_entry	*entry;
-
-	/* Replace existing argument. */
-	if ((entry = args_find(args, ch)) != NULL) {
-		free(entry->value);
-		if (value != NULL)
-			entry->value = xstrdup(value);
-		else
-			entry->value = NULL;
-		return;
-	}
-
-	entry = xcalloc(1, sizeof *entry);
-	entry->flag = ch;
-	if (value != NULL)
-		entry->value = xstrdup(value);
-
-	RB_INSERT(args_tree, &args->tree, entry);
+	return ((args->flags[ch >> 3] & args_bit(ch)) != 0);
 }
 
 /* Get argument value. Will be NULL if it isn't present. */
 const char *
 args_get(struct args *args, u_char ch)
 {
-	struct args_entry	*entry;
+	int	i;
 
-	if ((entry = args_find(args, ch)) == NULL)
+	if ((i = args_find(args, ch)) == -1)
 		return (NULL);
-	return (entry->value);
+	return (args->value[i]);
 }
 
 /* Convert an argument value to a number. */
@@ -236,16 +267,15 @@ long long
 args_strtonum(struct args *args, u_char ch, long long minval, long long maxval,
     char **cause)
 {
-	const char		*errstr;
+	const char		*errstr, *value;
 	long long 	 	 ll;
-	struct args_entry	*entry;
 
-	if ((entry = args_find(args, ch)) == NULL) {
+	if ((value = args_get(args, ch)) == NULL) {
 		*cause = xstrdup("missing");
 		return (0);
 	}
 
-	ll = strtonum(entry->value, minval, maxval, &errstr);
+	ll = strtonum(value, minval, maxval, &errstr);
 	if (errstr != NULL) {
 		*cause = xstrdup(errstr);
 		return (0);
@@ -23,19 +23,42 @@
 /* The currently focused client. */
 static struct client	*cur_client;
 
+/* How clients are hidden, unless their class or desktop says otherwise. */
+static int		 hide_default = CONFIG_HIDE_STRATEGY;
+static struct hide_rules hide_rules_q = TAILQ_HEAD_INITIALIZER(hide_rules_q);
+
+/* Index of all managed clients, hashed on their window id.  Every event
+ * carrying a window has to be mapped back to a client, so this avoids
+ * walking each monitor's desktops to find it.
+ */
+#define CLIENT_INDEX_MIN	64
+static struct client_index_bucket	*client_index;
+static u_int				 client_index_size;
+static u_int				 client_index_count;
+
 /* Forward declarations. */
 static void	 client_focus_model(struct client *);
-static void	 client_handle_initial_atoms(struct client *);
+static void	 client_handle_initial_atoms(struct client *,
+		     struct client_prefetch *);
+static void	 client_name_reply(struct client *, xcb_get_property_cookie_t,
+		     xcb_get_property_cookie_t);
+static void	 client_wm_protocols_reply(struct client *,
+		     xcb_get_property_cookie_t);
+static void	 client_wm_hints_reply(struct client *,
+		     xcb_get_property_cookie_t);
+static void	 client_size_hints_reply(struct client *,
+		     xcb_get_property_cookie_t);
+static u_int	 client_index_hash(xcb_window_t, u_int);
+static void	 client_index_resize(u_int);
+static void	 client_index_add(struct client *);
+static void	 client_index_remove(struct client *);
 
 struct client *
 client_create(xcb_window_t win)
 {
 	struct client	*new;
 
-	new = xmalloc(sizeof *new);
-	memset(new, 0, sizeof *new);
-
-	TAILQ_INIT(&new->geometries_q);
+	new = pool_get(POOL_CLIENT);
 
 	new->win = win;
 
@@ -48,25 +71,136 @@ client_get_current(void)
 	return (cur_client);
 }
 
+/* Make a client current, giving it the input focus and the focus border
+ * so what's advertised as active is what has the keyboard.  With no
+ * client, or one which takes no input, focus goes back to the root.
+ */
+void
+client_set_current(struct client *c)
+{
+	struct client	*old = cur_client;
+
+	if (c == old)
+		return;
+	cur_client = c;
+
+	/* An unmanaged client has already left the index. */
+	if (old != NULL && client_find_by_window(old->win) == old)
+		client_set_border_colour(old, UNFOCUS_BORDER);
+	if (c != NULL)
+		client_set_border_colour(c, FOCUS_BORDER);
+
+	if (c != NULL && (c->flags & CLIENT_INPUT_FOCUS)) {
+		xcb_set_input_focus(dpy, XCB_INPUT_FOCUS_POINTER_ROOT, c->win,
+		    XCB_CURRENT_TIME);
+	} else {
+		xcb_set_input_focus(dpy, XCB_INPUT_FOCUS_POINTER_ROOT,
+		    XCB_INPUT_FOCUS_POINTER_ROOT, XCB_CURRENT_TIME);
+	}
+
+	if (c != NULL)
+		desktop_set_current(c->desktop);
+	ewmh_set_active_window();
+	ewmh_set_current_desktop();
+}
+
+static u_int
+client_index_hash(xcb_window_t win, u_int size)
+{
+	/* Window ids from one client share their high bits and differ in the
+	 * low ones, so mix them before masking off a bucket.
+	 */
+	return ((win * 2654435761U) >> 7) & (size - 1);
+}
+
+static void
+client_index_resize(u_int size)
+{
+	struct client_index_bucket	*old = client_index;
+	struct client			*c;
+	u_int				 old_size = client_index_size, i, h;
+
+	client_index = xcalloc(size, sizeof *client_index);
+	client_index_size = size;
+	for (i = 0; i < size; i++)
+		LIST_INIT(&client_index[i]);
+
+	for (i = 0; i < old_size; i++) {
+		while ((c = LIST_FIRST(&old[i])) != NULL) {
+			LIST_REMOVE(c, index_entry);
+			h = client_index_hash(c->win, size);
+			LIST_INSERT_HEAD(&client_index[h], c, index_entry);
+		}
+	}
+	free(old);
+}
+
+static void
+client_index_add(struct client *c)
+{
+	u_int	 h;
+
+	if (client_index == NULL)
+		client_index_resize(CLIENT_INDEX_MIN);
+	else if (client_index_count >= client_index_size)
+		client_index_resize(client_index_size * 2);
+
+	h = client_index_hash(c->win, client_index_size);
+	LIST_INSERT_HEAD(&client_index[h], c, index_entry);
+	client_index_count++;
+}
+
+static void
+client_index_remove(struct client *c)
+{
+	LIST_REMOVE(c, index_entry);
+	client_index_count--;
+}
+
 struct client *
 client_find_by_window(xcb_window_t win)
 {
-	struct client	*c, *find_client = NULL;
+	struct client	*c;
+
+	if (client_index == NULL)
+		return (NULL);
+
+	LIST_FOREACH(c, &client_index[client_index_hash(win,
+	    client_index_size)], index_entry) {
+		if (c->win == win)
+			return (c);
+	}
+	return (NULL);
+}
+
+#ifdef DEBUG
+/* Check the window index agrees with the clients on each desktop. */
+void
+client_index_check(void)
+{
+	struct client	*c;
 	struct monitor	*m;
 	struct desktop	*d;
+	u_int		 n = 0;
 
 	TAILQ_FOREACH(m, &monitor_q, entry) {
-	       TAILQ_FOREACH(d, &m->desktops_q, entry) {
-		       TAILQ_FOREACH(c, &d->clients_q, entry) {
-			       if (c->win == win) {
-				       find_client = c;
-				       break;
-			       }
-		       }
-	       }
+		TAILQ_FOREACH(d, &m->desktops_q, entry) {
+			TAILQ_FOREACH(c, &d->clients_q, entry) {
+				if (client_find_by_window(c->win) != c) {
+					log_fatal("Client index is missing "
+					    "window 0x%x", c->win);
+				}
+				n++;
+			}
+		}
+	}
+
+	if (n != client_index_count) {
+		log_fatal("Client index has %u entries, desktops have %u",
+		    client_index_count, n);
 	}
-	return (find_client);
 }
+#endif
 
 static void
 client_focus_model(struct client *c)
@@ -81,43 +215,96 @@ client_focus_model(struct client *c)
 		c->flags |= CLIENT_INPUT_FOCUS;
 }
 
+/* Send every request needed to manage a window without waiting on any of
+ * the replies; client_manage_client() collects them afterwards, so the
+ * whole lot costs a single round-trip to the server.
+ */
+void
+client_prefetch(struct client_prefetch *pf, xcb_window_t win)
+{
+	memset(pf, 0, sizeof *pf);
+	pf->win = win;
+
+	pf->geometry = xcb_get_geometry(dpy, win);
+	pf->wm_class = xcb_icccm_get_wm_class(dpy, win);
+	pf->wm_hints = xcb_icccm_get_wm_hints(dpy, win);
+	if (ewmh->WM_PROTOCOLS != XCB_ATOM_NONE) {
+		pf->wm_protocols = xcb_icccm_get_wm_protocols(dpy, win,
+		    ewmh->WM_PROTOCOLS);
+	}
+	pf->wm_normal_hints = xcb_icccm_get_wm_normal_hints(dpy, win);
+
+	/* Ask for WM_NAME up front as well; it's cheaper to throw the reply
+	 * away than to go back for it if _NET_WM_NAME isn't set.
+	 */
+	pf->net_wm_name = xcb_get_property(dpy, 0, win, ewmh->_NET_WM_NAME,
+	    XCB_GET_PROPERTY_TYPE_ANY, 0, UINT_MAX);
+	pf->wm_name = xcb_get_property(dpy, 0, win, XCB_ATOM_WM_NAME,
+	    XCB_GET_PROPERTY_TYPE_ANY, 0, UINT_MAX);
+}
+
+/* Throw away the replies from a prefetch which won't be collected. */
+void
+client_prefetch_discard(struct client_prefetch *pf)
+{
+	if (pf->geometry.sequence != 0)
+		xcb_discard_reply(dpy, pf->geometry.sequence);
+	xcb_discard_reply(dpy, pf->wm_class.sequence);
+	xcb_discard_reply(dpy, pf->wm_hints.sequence);
+	if (pf->wm_protocols.sequence != 0)
+		xcb_discard_reply(dpy, pf->wm_protocols.sequence);
+	xcb_discard_reply(dpy, pf->wm_normal_hints.sequence);
+	xcb_discard_reply(dpy, pf->net_wm_name.sequence);
+	xcb_discard_reply(dpy, pf->wm_name.sequence);
+}
+
 static void
-client_handle_initial_atoms(struct client *c)
+client_handle_initial_atoms(struct client *c, struct client_prefetch *pf)
 {
 	/* This aggregates together all of the client Atoms we wish to check for
 	 * when a window is initially mapped.  Each of these routines are also
 	 * responded to by events.
 	 */
-	client_wm_hints(c);
-	client_wm_protocols(c);
+	client_wm_hints_reply(c, pf->wm_hints);
+	if (pf->wm_protocols.sequence != 0)
+		client_wm_protocols_reply(c, pf->wm_protocols);
 	client_mwm_hints(c);
-	client_get_size_hints(c);
-	client_set_name(c);
+	client_size_hints_reply(c, pf->wm_normal_hints);
+	client_name_reply(c, pf->net_wm_name, pf->wm_name);
 }
 
 void
 client_set_name(struct client *c)
 {
-	xcb_generic_error_t			*error;
-	xcb_get_property_cookie_t		 p_cookie;
-	xcb_get_property_reply_t		*r = NULL;
+	xcb_get_property_cookie_t	 net_ck, wm_ck;
 
-	p_cookie = xcb_get_property(dpy, 0, c->win, ewmh->_NET_WM_NAME,
-				    XCB_GET_PROPERTY_TYPE_ANY, 0, UINT_MAX);
+	net_ck = xcb_get_property(dpy, 0, c->win, ewmh->_NET_WM_NAME,
+				  XCB_GET_PROPERTY_TYPE_ANY, 0, UINT_MAX);
+	wm_ck = xcb_get_property(dpy, 0, c->win, XCB_ATOM_WM_NAME,
+				 XCB_GET_PROPERTY_TYPE_ANY, 0, UINT_MAX);
 
-	if (error) {
+	client_name_reply(c, net_ck, wm_ck);
+}
+
+static void
+client_name_reply(struct client *c, xcb_get_property_cookie_t net_ck,
+		  xcb_get_property_cookie_t wm_ck)
+{
+	xcb_get_property_reply_t		*r;
+
+	r = x_reply(xcb_get_property_reply, dpy, net_ck, NULL);
+
+	if (r == NULL || r->type == XCB_NONE || r->length == 0) {
 		log_msg("Couldn't get client's NET_WM_NAME");
 		log_msg("    Trying with WM_NAME instead...");
 
 		free(r);
-		p_cookie = xcb_get_property(dpy, 0, c->win, XCB_ATOM_WM_NAME,
-			     XCB_GET_PROPERTY_TYPE_ANY, 0, UINT_MAX);
-
-		r = xcb_get_property_reply(dpy, p_cookie, &error);
-	}
+		r = x_reply(xcb_get_property_reply, dpy, wm_ck, NULL);
+	} else
+		xcb_discard_reply(dpy, wm_ck.sequence);
 
+	free(c->name);
 	if (r != NULL && r->type != XCB_NONE && r->length > 0) {
-		free(c->name);
 		c->name = strndup(xcb_get_property_value(r),
 			    xcb_get_property_value_length(r));
 	} else
@@ -135,31 +322,38 @@ client_set_name(struct client *c)
 
 void
 client_wm_protocols(struct client *c)
+{
+	/* Check the atom exists. */
+	if (ewmh->WM_PROTOCOLS == XCB_ATOM_NONE)
+		return;
+
+	client_wm_protocols_reply(c,
+	    xcb_icccm_get_wm_protocols(dpy, c->win, ewmh->WM_PROTOCOLS));
+}
+
+static void
+client_wm_protocols_reply(struct client *c, xcb_get_property_cookie_t ck)
 {
 	xcb_icccm_get_wm_protocols_reply_t	 protocols;
-	xcb_atom_t				 wm_protocols = XCB_ATOM_NONE;
-	xcb_atom_t				 p_atom = XCB_ATOM_NONE;
 	int					 reply = 0;
 	u_int					 i;
 
-	/* Check the atom exists. */
-	if ((wm_protocols = ewmh->WM_PROTOCOLS) == XCB_ATOM_NONE)
-		return;
-
-	reply = xcb_icccm_get_wm_protocols_reply(dpy,
-			xcb_icccm_get_wm_protocols(dpy, c->win, wm_protocols),
-			    &protocols, NULL);
+	reply = x_reply(xcb_icccm_get_wm_protocols_reply, dpy, ck, &protocols,
+	    NULL);
 
 	if (reply) {
 		/* Fill out the client flags with the things we got back. */
 		for (i = 0; i < protocols.atoms_len; i++) {
-			p_atom = protocols.atoms[i];
-
-			if (p_atom == x_atom_by_name("WM_DELETE_WINDOW"))
+			switch (x_atom_lookup(protocols.atoms[i])) {
+			case X_ATOM_WM_DELETE_WINDOW:
 				c->flags |= CLIENT_DELETE_WINDOW;
-
-			if (p_atom == x_atom_by_name("WM_TAKE_FOCUS"))
+				break;
+			case X_ATOM_WM_TAKE_FOCUS:
 				c->flags |= CLIENT_INPUT_FOCUS;
+				break;
+			default:
+				break;
+			}
 		}
 		xcb_icccm_get_wm_protocols_reply_wipe(&protocols);
 	}
@@ -168,9 +362,14 @@ client_wm_protocols(struct client *c)
 void
 client_wm_hints(struct client *c)
 {
-	int reply = xcb_icccm_get_wm_hints_reply(
-		dpy, xcb_icccm_get_wm_hints(dpy, c->win),
-		&c->xwmh, NULL);
+	client_wm_hints_reply(c, xcb_icccm_get_wm_hints(dpy, c->win));
+}
+
+static void
+client_wm_hints_reply(struct client *c, xcb_get_property_cookie_t ck)
+{
+	int reply = x_reply(xcb_icccm_get_wm_hints_reply, dpy, ck, &c->xwmh,
+	    NULL);
 
 	if (reply == 0)
 		return;
@@ -187,12 +386,18 @@ client_mwm_hints(struct client *c)
 
 void
 client_get_size_hints(struct client *c)
+{
+	client_size_hints_reply(c, xcb_icccm_get_wm_normal_hints(dpy, c->win));
+}
+
+static void
+client_size_hints_reply(struct client *c, xcb_get_property_cookie_t ck)
 {
 	xcb_size_hints_t	 shints;
 	int			 reply = 0;
 
-	reply = xcb_icccm_get_wm_normal_hints_reply(dpy,
-		    xcb_icccm_get_wm_normal_hints(dpy, c->win), &shints, NULL);
+	reply = x_reply(xcb_icccm_get_wm_normal_hints_reply, dpy, ck, &shints,
+	    NULL);
 
 	if (reply == 0)
 		return;
@@ -232,10 +437,15 @@ client_get_size_hints(struct client *c)
 	c->hints.inc_h = MAX(1, c->hints.inc_h);
 }
 
-void
-client_manage_client(struct client *c, bool needs_map)
+/* Manage a client.  If pf is NULL, the window's properties are fetched
+ * here; otherwise the requests in pf are assumed to be in flight already.
+ * Returns -1 if the window went away before it could be managed.
+ */
+int
+client_manage_client(struct client *c, struct client_prefetch *pf,
+		     bool needs_map)
 {
-	struct geometry			 c_geom;
+	struct client_prefetch		 own_pf;
 	struct rectangle		 r;
 	struct monitor			*m;
 	xcb_get_geometry_reply_t	*geom_r;
@@ -243,12 +453,28 @@ client_manage_client(struct client *c, bool needs_map)
 	if (c == NULL)
 		log_fatal("Tried to manage a NULL client");
 
-	/* Get the window's geometry. */
-	geom_r = xcb_get_geometry_reply(dpy,
-		xcb_get_geometry(dpy, c->win), NULL);
+	rtt_op_begin("manage");
 
-	if (geom_r == NULL)
-		log_fatal("Window '0x%x' has no geometry", c->win);
+	if (pf == NULL) {
+		client_prefetch(&own_pf, c->win);
+		pf = &own_pf;
+	}
+
+	/* Get the window's geometry.  This is the first reply we wait on;
+	 * the rest of the prefetch will have arrived alongside it.
+	 */
+	geom_r = x_reply(xcb_get_geometry_reply, dpy, pf->geometry, NULL);
+
+	if (geom_r == NULL) {
+		/* The window was most likely destroyed while the requests
+		 * were in flight.
+		 */
+		log_msg("Window '0x%x' has no geometry", c->win);
+		pf->geometry.sequence = 0;
+		client_prefetch_discard(pf);
+		rtt_op_end();
+		return (-1);
+	}
 	log_msg("Window '0x%x' has geom: %ux%u+%d+%d",
 		c->win, geom_r->width, geom_r->height, geom_r->x, geom_r->y);
 
@@ -257,21 +483,16 @@ client_manage_client(struct client *c, bool needs_map)
 	r.w = geom_r->width;
 	r.h = geom_r->height;
 
-	memcpy(&c_geom.coords, &r, sizeof(struct rectangle));
-	c_geom.bw = CONFIG_BW;
+	memcpy(&c->geom.coords, &r, sizeof(struct rectangle));
+	c->geom.bw = CONFIG_BW;
+	c->geom.state = NORMAL;
 
 	free(geom_r);
 
-	/* Add this to the set of geometries. */
-	if (TAILQ_EMPTY(&c->geometries_q))
-		TAILQ_INSERT_HEAD(&c->geometries_q, &c_geom, entry);
-	else
-		TAILQ_INSERT_TAIL(&c->geometries_q, &c_geom, entry);
-
 	/* Add the client to our list.  Its position will dictate which
 	 * desktop and hence monitor it is on.
 	 */
-	if ((m = monitor_at_xy(r.x, r.y)) == NULL)
+	if ((m = monitor_nearest(r.x, r.y)) == NULL)
 		log_fatal("No monitor found at x: %d, y: %d", r.x, r.y);
 
 	/* XXX: How do we handle clients destined for different
@@ -279,28 +500,68 @@ client_manage_client(struct client *c, bool needs_map)
 	 * _NET_WM_DESKTOP
 	 */
 	if (m->active_desktop == NULL)
-		m->active_desktop = TAILQ_FIRST(&m->desktops_q);
+		m->active_desktop = desktop_get(m, 0);
 
 	if (TAILQ_EMPTY(&m->active_desktop->clients_q))
 		TAILQ_INSERT_HEAD(&m->active_desktop->clients_q, c, entry);
 	else
 		TAILQ_INSERT_TAIL(&m->active_desktop->clients_q, c, entry);
+	c->desktop = m->active_desktop;
+	client_index_add(c);
+	ewmh_client_list_add(c->win);
+	ewmh_set_wm_desktop(c);
+	ewmh_set_wm_state(c);
 
 	/* Set the application's Class/resource hint here---applications at this
 	 * point are still in the Withdrawn state, and might still have changed
 	 * their XClassHint.
 	 */
-	(void)xcb_icccm_get_wm_class_reply(dpy,
-	    xcb_icccm_get_wm_class(dpy, c->win), &c->xch, NULL);
+	(void)x_reply(xcb_icccm_get_wm_class_reply, dpy, pf->wm_class, &c->xch,
+	    NULL);
 
 	/* Check the client for any Atom hints. */
-	client_handle_initial_atoms(c);
+	client_handle_initial_atoms(c, pf);
 
 	/* Borders. */
-	client_set_bw(c, &c_geom);
-	client_set_border_colour(c, 0);
+	client_set_bw(c, &c->geom);
+	client_set_border_colour(c, UNFOCUS_BORDER);
 
 	grab_all_bindings(c->win);
+
+	log_msg("Window '0x%x' managed in %u round-trip(s)", c->win,
+	    rtt_op_end());
+
+	return (0);
+}
+
+/* Stop managing a client whose window has gone away, and free it. */
+void
+client_unmanage(struct client *c)
+{
+	if (c == NULL)
+		log_fatal("Tried to unmanage a NULL client");
+
+	log_msg("Unmanaging window '0x%x'", c->win);
+
+	drag_cancel(c);
+
+	if (c->desktop != NULL)
+		TAILQ_REMOVE(&c->desktop->clients_q, c, entry);
+	client_index_remove(c);
+	ewmh_client_list_remove(c->win);
+	ewmh_prop_forget(c->win);
+
+	if (cur_client == c)
+		client_set_current(NULL);
+
+	if (c->xch._reply != NULL)
+		xcb_icccm_get_wm_class_reply_wipe(&c->xch);
+	free(c->name);
+	pool_put(POOL_CLIENT, c);
+
+#ifdef DEBUG
+	client_index_check();
+#endif
 }
 
 void
@@ -313,27 +574,237 @@ client_set_bw(struct client *c, struct geometry *g)
 
 	mask |= XCB_CONFIG_WINDOW_BORDER_WIDTH;
 	xcb_configure_window(dpy, c->win, mask, &values[0]);
-	xcb_flush(dpy);
 }
 
-uint32_t client_get_colour(const char *colour)
+/* Tell the server about the client's current geometry. */
+void
+client_apply_geometry(struct client *c)
+{
+	struct rectangle	*r = &c->geom.coords;
+	uint32_t		 values[5];
+	uint16_t		 mask;
+
+	mask = XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+	    XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT |
+	    XCB_CONFIG_WINDOW_BORDER_WIDTH;
+	values[0] = r->x;
+	values[1] = r->y;
+	values[2] = r->w;
+	values[3] = r->h;
+	values[4] = c->geom.bw;
+
+	xcb_configure_window(dpy, c->win, mask, values);
+}
+
+void
+client_set_hide_default(int hide)
+{
+	hide_default = hide;
+}
+
+/* Set how clients of a class are hidden, or -1 to remove the rule. */
+void
+client_set_hide_rule(const char *class, int hide)
 {
-	xcb_alloc_named_color_reply_t	*col_r;
-	xcb_colormap_t			 cmap;
-	xcb_generic_error_t		*error;
-	xcb_alloc_named_color_cookie_t	 col_ck;
-	uint32_t			 pixel;
+	struct hide_rule	*r;
 
-	cmap = current_screen->default_colormap;
-	col_ck = xcb_alloc_named_color(dpy, cmap, strlen(colour), colour);
-	col_r = xcb_alloc_named_color_reply(dpy, col_ck, &error);
-	if (error != NULL)
-		log_fatal("Couldn't get pixel value for colour %s", colour);
+	TAILQ_FOREACH(r, &hide_rules_q, entry) {
+		if (strcmp(r->class, class) == 0)
+			break;
+	}
 
-	pixel = col_r->pixel;
-	free(col_r);
+	if (hide == -1) {
+		if (r != NULL) {
+			TAILQ_REMOVE(&hide_rules_q, r, entry);
+			free(r->class);
+			free(r);
+		}
+		return;
+	}
 
-	return (pixel);
+	if (r == NULL) {
+		r = xcalloc(1, sizeof *r);
+		r->class = xstrdup(class);
+		TAILQ_INSERT_TAIL(&hide_rules_q, r, entry);
+	}
+	r->hide = hide;
+}
+
+int
+client_hide_strategy(struct client *c)
+{
+	struct hide_rule	*r;
+
+	if (c->xch._reply != NULL) {
+		TAILQ_FOREACH(r, &hide_rules_q, entry) {
+			if (strcmp(r->class, c->xch.class_name) == 0 ||
+			    strcmp(r->class, c->xch.instance_name) == 0)
+				return (r->hide);
+		}
+	}
+
+	if (c->desktop != NULL && c->desktop->hide != -1)
+		return (c->desktop->hide);
+	return (hide_default);
+}
+
+/* Show a hidden client.  A parked client is just moved back, to its
+ * geometry as it is now in case that changed while it was parked.
+ */
+void
+client_show(struct client *c)
+{
+	if (!(c->flags & CLIENT_HIDDEN))
+		return;
+
+	if (c->flags & CLIENT_PARKED)
+		client_apply_geometry(c);
+	else
+		xcb_map_window(dpy, c->win);
+
+	c->flags &= ~(CLIENT_HIDDEN|CLIENT_PARKED);
+	ewmh_set_wm_state(c);
+}
+
+/* Hide a client.  Parking leaves it mapped, but off the left of the root,
+ * so it needn't redraw itself when shown again.
+ */
+void
+client_hide(struct client *c)
+{
+	uint32_t	 values[1];
+
+	if (c->flags & CLIENT_HIDDEN)
+		return;
+
+	if (client_hide_strategy(c) == HIDE_PARK) {
+		values[0] = -(c->geom.coords.w + 2 * c->geom.bw);
+		xcb_configure_window(dpy, c->win, XCB_CONFIG_WINDOW_X, values);
+		c->flags |= CLIENT_PARKED;
+	} else
+		xcb_unmap_window(dpy, c->win);
+
+	c->flags |= CLIENT_HIDDEN;
+	ewmh_set_wm_state(c);
+}
+
+/* Move a client to another desktop, showing or hiding it to match. */
+void
+client_move_to_desktop(struct client *c, struct desktop *d)
+{
+	if (c->desktop == d)
+		return;
+
+	if (c->desktop != NULL)
+		TAILQ_REMOVE(&c->desktop->clients_q, c, entry);
+	TAILQ_INSERT_TAIL(&d->clients_q, c, entry);
+	c->desktop = d;
+
+	if (d->monitor != NULL && d->monitor->active_desktop == d)
+		client_show(c);
+	else
+		client_hide(c);
+	ewmh_set_wm_desktop(c);
+}
+
+/* Place a client on a monitor where it was on the rectangle from, keeping
+ * its position relative to the monitor and as much of it as will fit on
+ * screen.
+ */
+void
+client_fit_to_monitor(struct client *c, struct rectangle *from,
+    struct monitor *m)
+{
+	struct geometry	*g = &c->geom;
+	int		 w, h;
+
+	if (g->state == MAXIMISED || g->state == FULLSCREEN) {
+		g->coords.x = m->size.x;
+		g->coords.y = m->size.y;
+		g->coords.w = MAX(1, m->size.w - 2 * g->bw);
+		g->coords.h = MAX(1, m->size.h - 2 * g->bw);
+	} else {
+		w = g->coords.w + 2 * g->bw;
+		h = g->coords.h + 2 * g->bw;
+
+		g->coords.x = m->size.x + (g->coords.x - from->x);
+		g->coords.y = m->size.y + (g->coords.y - from->y);
+		g->coords.x = MIN(g->coords.x, m->size.x + m->size.w - w);
+		g->coords.y = MIN(g->coords.y, m->size.y + m->size.h - h);
+		g->coords.x = MAX(g->coords.x, m->size.x);
+		g->coords.y = MAX(g->coords.y, m->size.y);
+	}
+
+	/* A parked client is put back when it's shown. */
+	if (!(c->flags & CLIENT_PARKED))
+		client_apply_geometry(c);
+}
+
+void
+client_raise(struct client *c)
+{
+	uint32_t	 values[1];
+
+	values[0] = XCB_STACK_MODE_ABOVE;
+	xcb_configure_window(dpy, c->win, XCB_CONFIG_WINDOW_STACK_MODE,
+	    values);
+	ewmh_client_list_raise(c->win);
+}
+
+/* Remember the current geometry, so it can be gone back to. */
+void
+client_push_geometry(struct client *c)
+{
+	struct geometry_history	*h = &c->history;
+
+	h->ring[h->head] = c->geom;
+	h->head = (h->head + 1) % CONFIG_GEOMETRY_HISTORY;
+	if (h->len < CONFIG_GEOMETRY_HISTORY)
+		h->len++;
+}
+
+struct geometry *
+client_peek_geometry(struct client *c)
+{
+	struct geometry_history	*h = &c->history;
+
+	if (h->len == 0)
+		return (NULL);
+	return (&h->ring[(h->head + CONFIG_GEOMETRY_HISTORY - 1) %
+	    CONFIG_GEOMETRY_HISTORY]);
+}
+
+int
+client_pop_geometry(struct client *c, struct geometry *g)
+{
+	struct geometry_history	*h = &c->history;
+	struct geometry		*last;
+
+	if ((last = client_peek_geometry(c)) == NULL)
+		return (-1);
+	if (g != NULL)
+		*g = *last;
+
+	h->head = (h->head + CONFIG_GEOMETRY_HISTORY - 1) %
+	    CONFIG_GEOMETRY_HISTORY;
+	h->len--;
+
+	return (0);
+}
+
+/* Put the client back where it was before the last change. */
+int
+client_restore_geometry(struct client *c)
+{
+	if (client_pop_geometry(c, &c->geom) != 0)
+		return (-1);
+
+	log_msg("Restoring 0x%x to %dx%d+%d+%d", c->win, c->geom.coords.w,
+	    c->geom.coords.h, c->geom.coords.x, c->geom.coords.y);
+	client_apply_geometry(c);
+	ewmh_set_wm_state(c);
+
+	return (0);
 }
 
 void
@@ -341,26 +812,31 @@ client_set_border_colour(struct client *c, int type)
 {
 	uint32_t	 values[1];
 
-	values[0] = type == FOCUS_BORDER                ?
-		client_get_colour(CONFIG_FOCUS_COLOUR)	:
-		client_get_colour(CONFIG_NFOCUS_COLOUR);
+	values[0] = colour_get_pixel(type);
 
 	xcb_change_window_attributes(dpy, c->win, XCB_CW_BORDER_PIXEL,
 			             values);
 }
 
+/* Manage all existing windows on the root.  This is done in phases so
+ * that the number of round-trips doesn't grow with the number of windows:
+ * the attributes of every child are requested together, and then the
+ * properties of every viewable one.
+ */
 void
 client_scan_windows(void)
 {
 	xcb_query_tree_reply_t			*reply;
 	xcb_get_window_attributes_reply_t	*attr;
+	xcb_get_window_attributes_cookie_t	*attr_ck;
+	struct client_prefetch			*pf;
 	xcb_window_t				*children;
-	int					 i;
+	int					 i, n;
 	int					 len;
 	struct client				*client;
 
 	/* Get all children. */
-	reply = xcb_query_tree_reply(dpy,
+	reply = x_reply(xcb_query_tree_reply, dpy,
 	xcb_query_tree(dpy, current_screen->root), 0);
 	if (reply == NULL)
 		log_fatal("Couldn't get a list of windows");
@@ -368,12 +844,23 @@ client_scan_windows(void)
 	len = xcb_query_tree_children_length(reply);
 	children = xcb_query_tree_children(reply);
 
-	/* Set up all windows on this root. */
-	for (i = 0; i < len; i ++)
+	if (len == 0) {
+		free(reply);
+		return;
+	}
+
+	attr_ck = xcalloc(len, sizeof *attr_ck);
+	pf = xcalloc(len, sizeof *pf);
+
+	for (i = 0; i < len; i++)
+		attr_ck[i] = xcb_get_window_attributes(dpy, children[i]);
+
+	/* Only prefetch windows we would manage. */
+	n = 0;
+	for (i = 0; i < len; i++)
 	{
-		attr = xcb_get_window_attributes_reply(dpy,
-				xcb_get_window_attributes(dpy, children[i]),
-				NULL);
+		attr = x_reply(xcb_get_window_attributes_reply, dpy,
+		    attr_ck[i], NULL);
 
 		if (attr == NULL) {
 			log_msg("Couldn't get attributes for window %d",
@@ -382,15 +869,22 @@ client_scan_windows(void)
 		}
 
 		if (!attr->override_redirect &&
-		    attr->map_state == XCB_MAP_STATE_VIEWABLE) {
-			if ((client = client_create(children[i])) == NULL)
-				log_fatal("Couldn't handle creating client");
+		    attr->map_state == XCB_MAP_STATE_VIEWABLE)
+			client_prefetch(&pf[n++], children[i]);
+		free(attr);
+	}
+	log_msg("Scan: %d windows, %d to manage", len, n);
 
-			client_manage_client(client, true);
+	/* Set up all windows on this root. */
+	for (i = 0; i < n; i++) {
+		if ((client = client_create(pf[i].win)) == NULL)
+			log_fatal("Couldn't handle creating client");
 
-		}
-		free(attr);
+		if (client_manage_client(client, &pf[i], true) != 0)
+			pool_put(POOL_CLIENT, client);
 	}
+
+	free(pf);
+	free(attr_ck);
 	free(reply);
-	xcb_flush(dpy);
 }
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2013 Thomas Adam <thomas@xteddy.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Command to measure how quickly commands are parsed.  It runs inside the
+ * event loop, so it's only built with BENCH and the count is kept small.
+ */
+
+#include "lswm.h"
+
+#ifdef BENCH
+
+#define BENCH_PARSE_COUNT 10000
+#define BENCH_PARSE_MAX 100000
+
+enum cmd_retval	 cmd_bench_parse_exec(struct cmd *, struct cmd_q *);
+
+struct cmd_entry cmd_bench_parse = {
+	"bench-parse",
+	NULL,
+	"n:",
+	1,
+	1,
+	"bench-parse [-n count] command",
+	cmd_bench_parse_exec
+};
+
+enum cmd_retval
+cmd_bench_parse_exec(struct cmd *self, struct cmd_q *cmdq)
+{
+	struct args		*args = self->args;
+	struct cmd_list		*cmdlist;
+	struct cmd		*cmd;
+	const char		*s = args->argv[0], *name;
+	char			*cause;
+	uint64_t		 start, parse_us, find_us;
+	long long		 count = BENCH_PARSE_COUNT, i;
+
+	if (args_has(args, 'n')) {
+		count = args_strtonum(args, 'n', 1, BENCH_PARSE_MAX, &cause);
+		if (cause != NULL) {
+			cmdq_error(cmdq, "count %s", cause);
+			free(cause);
+			return (CMD_RETURN_ERROR);
+		}
+	}
+
+	/* Parse it once first, both to check it and for its name. */
+	if (cmd_string_parse(s, &cmdlist, NULL, 0, &cause) != 0) {
+		cmdq_error(cmdq, "%s", cause != NULL ? cause : "no command");
+		free(cause);
+		return (CMD_RETURN_ERROR);
+	}
+	cmd = TAILQ_FIRST(&cmdlist->list);
+	name = cmd->entry->name;
+	cmd_list_free(cmdlist);
+
+	start = event_now();
+	for (i = 0; i < count; i++) {
+		if (cmd_string_parse(s, &cmdlist, NULL, 0, &cause) == 0)
+			cmd_list_free(cmdlist);
+		else
+			free(cause);
+	}
+	parse_us = event_now() - start;
+
+	start = event_now();
+	for (i = 0; i < count; i++)
+		(void)cmd_find_cmd(name, NULL);
+	find_us = event_now() - start;
+
+	cmdq_print(cmdq, "parse:  %lld in %llu us, %llu ns each, %llu/s",
+	    count, (unsigned long long)parse_us,
+	    (unsigned long long)(parse_us * 1000 / count),
+	    (unsigned long long)(parse_us == 0 ? 0 :
+	    count * 1000000ULL / parse_us));
+	cmdq_print(cmdq, "lookup: %lld in %llu us, %llu ns each", count,
+	    (unsigned long long)find_us,
+	    (unsigned long long)(find_us * 1000 / count));
+
+	return (CMD_RETURN_NORMAL);
+}
+
+#endif
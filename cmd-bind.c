@@ -22,6 +22,7 @@ enum cmd_retval	 cmd_bindm_exec(struct cmd *, struct cmd_q *);
 
 struct cmd_entry cmd_bindm = {
 	"bindm",
+	NULL,
 	"0123m:",
 	0,
 	1,
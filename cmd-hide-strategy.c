@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2013 Thomas Adam <thomas@xteddy.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Command to set how clients on hidden desktops are hidden. */
+
+#include <string.h>
+#include "lswm.h"
+
+enum cmd_retval	 cmd_hide_strategy_exec(struct cmd *, struct cmd_q *);
+
+struct cmd_entry cmd_hide_strategy = {
+	"hide-strategy",
+	NULL,
+	"c:d",
+	1,
+	1,
+	"hide-strategy [-d] [-c class] unmap|park|default",
+	cmd_hide_strategy_exec
+};
+
+enum cmd_retval
+cmd_hide_strategy_exec(struct cmd *self, struct cmd_q *cmdq)
+{
+	struct args	*args = self->args;
+	struct desktop	*d;
+	const char	*how = args->argv[0];
+	int		 hide;
+
+	if (strcmp(how, "unmap") == 0)
+		hide = HIDE_UNMAP;
+	else if (strcmp(how, "park") == 0)
+		hide = HIDE_PARK;
+	else if (strcmp(how, "default") == 0)
+		hide = -1;
+	else {
+		cmdq_error(cmdq, "unknown hide strategy: %s", how);
+		return (CMD_RETURN_ERROR);
+	}
+
+	/* For one class of client, wherever it is. */
+	if (args_has(args, 'c')) {
+		client_set_hide_rule(args_get(args, 'c'), hide);
+		return (CMD_RETURN_NORMAL);
+	}
+
+	/* For the current desktop. */
+	if (args_has(args, 'd')) {
+		if ((d = desktop_get_current()) == NULL) {
+			cmdq_error(cmdq, "no current desktop");
+			return (CMD_RETURN_ERROR);
+		}
+		d->hide = hide;
+		return (CMD_RETURN_NORMAL);
+	}
+
+	/* Otherwise for everything. */
+	client_set_hide_default(hide == -1 ? CONFIG_HIDE_STRATEGY : hide);
+
+	return (CMD_RETURN_NORMAL);
+}
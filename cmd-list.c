@@ -91,7 +91,7 @@ cmd_list_free(struct cmd_list *cmdlist)
 		TAILQ_REMOVE(&cmdlist->list, cmd, qentry);
 		args_free(cmd->args);
 		free(cmd->file);
-		free(cmd);
+		pool_put(POOL_CMD, cmd);
 	}
 
 	free(cmdlist);
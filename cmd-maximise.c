@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2013 Thomas Adam <thomas@xteddy.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Command to maximise a window, or make it fullscreen. */
+
+#include "lswm.h"
+
+enum cmd_retval	 cmd_maximise_exec(struct cmd *, struct cmd_q *);
+
+struct cmd_entry cmd_maximise = {
+	"maximise",
+	"maximize",
+	"f",
+	0,
+	1,
+	"maximise [-f]",
+	cmd_maximise_exec
+};
+
+enum cmd_retval
+cmd_maximise_exec(struct cmd *self, struct cmd_q *cmdq)
+{
+	struct args		*args = self->args;
+	struct client		*c;
+	struct monitor		*m;
+	struct geometry		*g;
+	enum geometry_state	 state;
+
+	if ((c = cmd_get_context(self, cmdq)) == NULL) {
+		cmdq_error(cmdq, "no window to maximise");
+		return (CMD_RETURN_ERROR);
+	}
+	g = &c->geom;
+	state = args_has(args, 'f') ? FULLSCREEN : MAXIMISED;
+
+	/* Toggling off is going back to whatever came before. */
+	if (g->state == state) {
+		if (client_restore_geometry(c) == 0)
+			return (CMD_RETURN_NORMAL);
+	}
+
+	m = monitor_nearest(g->coords.x + g->coords.w / 2,
+	    g->coords.y + g->coords.h / 2);
+	if (m == NULL) {
+		cmdq_error(cmdq, "no monitor for window");
+		return (CMD_RETURN_ERROR);
+	}
+
+	client_push_geometry(c);
+
+	g->state = state;
+	if (state == FULLSCREEN)
+		g->bw = 0;
+	g->coords.x = m->size.x;
+	g->coords.y = m->size.y;
+	g->coords.w = MAX(1, m->size.w - 2 * g->bw);
+	g->coords.h = MAX(1, m->size.h - 2 * g->bw);
+
+	client_apply_geometry(c);
+	client_raise(c);
+	ewmh_set_wm_state(c);
+
+	return (CMD_RETURN_NORMAL);
+}
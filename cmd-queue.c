@@ -52,7 +52,9 @@ cmdq_free(struct cmd_q *cmdq)
 	return (1);
 }
 
-/* Show error from command. */
+/* Show error from command, to whoever ran it if they can be told, or else
+ * the log.
+ */
 void printflike2
 cmdq_error(struct cmd_q *cmdq, const char *fmt, ...)
 {
@@ -64,12 +66,39 @@ cmdq_error(struct cmd_q *cmdq, const char *fmt, ...)
 	vasprintf(&msg, fmt, ap);
 	va_end(ap);
 
-	xasprintf(&cause, "%s:%u: %s", cmd->file, cmd->line, msg);
-	ARRAY_ADD(&cfg_causes, cause);
+	cmdq->errors++;
+	if (cmdq->printfn != NULL) {
+		xasprintf(&cause, "error: %s", msg);
+		cmdq->printfn(cmdq, cause);
+		free(cause);
+	} else if (cmd->file != NULL)
+		log_msg("%s:%u: %s", cmd->file, cmd->line, msg);
+	else
+		log_msg("%s", msg);
 
 	free(msg);
 }
 
+/* Show output from a command, or log it if there's no queue to show it
+ * on.
+ */
+void printflike2
+cmdq_print(struct cmd_q *cmdq, const char *fmt, ...)
+{
+	va_list		 ap;
+	char		*msg;
+
+	va_start(ap, fmt);
+	vasprintf(&msg, fmt, ap);
+	va_end(ap);
+
+	if (cmdq != NULL && cmdq->printfn != NULL)
+		cmdq->printfn(cmdq, msg);
+	else
+		log_msg("%s", msg);
+
+	free(msg);
+}
 
 /* Add command list to queue and begin processing if needed. */
 void
@@ -89,7 +118,7 @@ cmdq_append(struct cmd_q *cmdq, struct cmd_list *cmdlist)
 {
 	struct cmd_q_item	*item;
 
-	item = xcalloc(1, sizeof *item);
+	item = pool_get(POOL_CMDQ_ITEM);
 	item->cmdlist = cmdlist;
 	TAILQ_INSERT_TAIL(&cmdq->queue, item, qentry);
 	cmdlist->references++;
@@ -126,15 +155,17 @@ cmdq_continue(struct cmd_q *cmdq)
 
 			retval = cmdq->cmd->entry->exec(cmdq->cmd, cmdq);
 
-			if (retval == CMD_RETURN_ERROR)
+			if (retval == CMD_RETURN_ERROR) {
+				cmdq->failed = 1;
 				break;
+			}
 
 			cmdq->cmd = TAILQ_NEXT(cmdq->cmd, qentry);
 		}
 
 		TAILQ_REMOVE(&cmdq->queue, cmdq->item, qentry);
 		cmd_list_free(cmdq->item->cmdlist);
-		free(cmdq->item);
+		pool_put(POOL_CMDQ_ITEM, cmdq->item);
 
 		cmdq->item = next;
 		if (cmdq->item != NULL)
@@ -158,7 +189,7 @@ cmdq_flush(struct cmd_q *cmdq)
 	TAILQ_FOREACH_SAFE(item, &cmdq->queue, qentry, item1) {
 		TAILQ_REMOVE(&cmdq->queue, item, qentry);
 		cmd_list_free(item->cmdlist);
-		free(item);
+		pool_put(POOL_CMDQ_ITEM, item);
 	}
 	cmdq->item = NULL;
 }
@@ -22,17 +22,35 @@ enum cmd_retval	 cmd_move_exec(struct cmd *, struct cmd_q *);
 
 struct cmd_entry cmd_move = {
 	"move",
-	"v",
+	NULL,
+	"ruv",
 	0,
 	1,
-	"move [-v]",
+	"move [-ruv]",
 	cmd_move_exec
 };
 
 enum cmd_retval
 cmd_move_exec(struct cmd *self, struct cmd_q *cmdq)
 {
-	log_msg("I would move this window!...");
+	struct args	*args = self->args;
+	struct client	*c;
+
+	if ((c = cmd_get_context(self, cmdq)) == NULL) {
+		cmdq_error(cmdq, "no window to move");
+		return (CMD_RETURN_ERROR);
+	}
+
+	if (args_has(args, 'u')) {
+		if (client_restore_geometry(c) != 0) {
+			cmdq_error(cmdq, "nothing to undo");
+			return (CMD_RETURN_ERROR);
+		}
+		return (CMD_RETURN_NORMAL);
+	}
+
+	/* Follow the pointer until a button is pressed or released. */
+	drag_start(c, args_has(args, 'r') ? DRAG_RESIZE : DRAG_MOVE);
 
 	return (CMD_RETURN_NORMAL);
 }
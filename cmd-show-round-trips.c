@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2013 Thomas Adam <thomas@xteddy.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Show time spent waiting on replies from the X server. */
+
+#include "lswm.h"
+
+enum cmd_retval	 cmd_show_round_trips_exec(struct cmd *, struct cmd_q *);
+
+struct cmd_entry cmd_show_round_trips = {
+	"show-round-trips",
+	NULL,
+	"",
+	0,
+	0,
+	"show-round-trips",
+	cmd_show_round_trips_exec
+};
+
+enum cmd_retval
+cmd_show_round_trips_exec(unused struct cmd *self, struct cmd_q *cmdq)
+{
+	rtt_summary(cmdq);
+
+	return (CMD_RETURN_NORMAL);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2013 Thomas Adam <thomas@xteddy.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Command to switch to another desktop. */
+
+#include "lswm.h"
+
+enum cmd_retval	 cmd_switch_desktop_exec(struct cmd *, struct cmd_q *);
+
+struct cmd_entry cmd_switch_desktop = {
+	"switch-desktop",
+	"desktop",
+	"",
+	1,
+	1,
+	"switch-desktop number",
+	cmd_switch_desktop_exec
+};
+
+enum cmd_retval
+cmd_switch_desktop_exec(struct cmd *self, struct cmd_q *cmdq)
+{
+	struct args	*args = self->args;
+	struct desktop	*d;
+	struct monitor	*m;
+	const char	*errstr;
+	long long	 idx;
+
+	idx = strtonum(args->argv[0], 0, CONFIG_DESKTOPS - 1, &errstr);
+	if (errstr != NULL) {
+		cmdq_error(cmdq, "desktop number %s: %s", args->argv[0],
+		    errstr);
+		return (CMD_RETURN_ERROR);
+	}
+
+	/* Switch the monitor showing the current desktop. */
+	if ((d = desktop_get_current()) != NULL)
+		m = d->monitor;
+	else
+		m = TAILQ_FIRST(&monitor_q);
+	if (m == NULL) {
+		cmdq_error(cmdq, "no monitor to switch");
+		return (CMD_RETURN_ERROR);
+	}
+
+	desktop_switch(m, idx);
+
+	return (CMD_RETURN_NORMAL);
+}
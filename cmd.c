@@ -20,28 +20,132 @@
 #include "lswm.h"
 
 struct cmd_entry	*cmd_table[] = {
+#ifdef BENCH
+	&cmd_bench_parse,
+#endif
 	&cmd_bindm,
+	&cmd_hide_strategy,
+	&cmd_maximise,
 	&cmd_move,
+	&cmd_show_pools,
+	&cmd_show_round_trips,
+	&cmd_show_switch_times,
+	&cmd_switch_desktop,
 	NULL
 };
 
+/* Every command's name and alias, sorted so they can be searched. */
+struct cmd_name {
+	const char		*name;
+	struct cmd_entry	*entry;
+};
+static struct cmd_name	*cmd_names;
+static u_int		 cmd_nnames;
+
+static int	 cmd_name_cmp(const void *, const void *);
+static void	 cmd_names_init(void);
+
+static int
+cmd_name_cmp(const void *a, const void *b)
+{
+	const struct cmd_name	*n1 = a, *n2 = b;
+
+	return (strcmp(n1->name, n2->name));
+}
+
+/* Build the sorted names, checking each command's definition as it goes. */
+static void
+cmd_names_init(void)
+{
+	struct cmd_entry	**cmd_ent;
+	u_int			  i;
+
+	for (cmd_ent = cmd_table; *cmd_ent != NULL; cmd_ent++) {
+		if (args_template_values((*cmd_ent)->args_template) >
+		    ARGS_VALUES) {
+			log_fatal("command %s has too many flags with values",
+			    (*cmd_ent)->name);
+		}
+		cmd_nnames += (*cmd_ent)->alias != NULL ? 2 : 1;
+	}
+	cmd_names = xcalloc(cmd_nnames, sizeof *cmd_names);
+
+	i = 0;
+	for (cmd_ent = cmd_table; *cmd_ent != NULL; cmd_ent++) {
+		cmd_names[i].name = (*cmd_ent)->name;
+		cmd_names[i++].entry = *cmd_ent;
+		if ((*cmd_ent)->alias != NULL) {
+			cmd_names[i].name = (*cmd_ent)->alias;
+			cmd_names[i++].entry = *cmd_ent;
+		}
+	}
+	qsort(cmd_names, cmd_nnames, sizeof *cmd_names, cmd_name_cmp);
+
+	for (i = 1; i < cmd_nnames; i++) {
+		if (strcmp(cmd_names[i - 1].name, cmd_names[i].name) == 0)
+			log_fatal("command %s defined twice", cmd_names[i].name);
+	}
+}
+
+/* Find a command by its name or alias, or any unique prefix of either. */
 struct cmd_entry *
-cmd_find_cmd(const char *cmd_name)
+cmd_find_cmd(const char *cmd_name, char **cause)
 {
-	struct cmd_entry	**cmd_ent = NULL;
-	struct cmd_entry	*cmd_p = NULL;
+	struct cmd_entry	*found = NULL;
+	char			 s[BUFSIZ];
+	size_t			 len, off;
+	u_int			 lo, hi, mid, i;
 
 	if (cmd_name == NULL)
 		log_fatal("command name was NULL");
+	if (cmd_names == NULL)
+		cmd_names_init();
 
-	for (cmd_ent = cmd_table; *cmd_ent != NULL; cmd_ent++) {
-		if (strcmp((*cmd_ent)->name, cmd_name) == 0) {
-			cmd_p = *cmd_ent;
+	/* Find the first name not less than the one given. */
+	lo = 0;
+	hi = cmd_nnames;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (strcmp(cmd_names[mid].name, cmd_name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < cmd_nnames && strcmp(cmd_names[lo].name, cmd_name) == 0)
+		return (cmd_names[lo].entry);
+
+	/* Names it's a prefix of follow on from there. */
+	len = strlen(cmd_name);
+	for (i = lo; i < cmd_nnames; i++) {
+		if (strncmp(cmd_names[i].name, cmd_name, len) != 0)
 			break;
-		}
+		if (found != NULL && cmd_names[i].entry != found)
+			goto ambiguous;
+		found = cmd_names[i].entry;
 	}
 
-	return (cmd_p);
+	if (found == NULL && cause != NULL)
+		xasprintf(cause, "unknown command: %s", cmd_name);
+	return (found);
+
+ambiguous:
+	if (cause == NULL)
+		return (NULL);
+
+	*s = '\0';
+	off = 0;
+	found = NULL;
+	for (i = lo; i < cmd_nnames && off < sizeof s; i++) {
+		if (strncmp(cmd_names[i].name, cmd_name, len) != 0)
+			break;
+		if (cmd_names[i].entry == found)
+			continue;
+		found = cmd_names[i].entry;
+		off += snprintf(s + off, sizeof s - off, "%s%s",
+		    off == 0 ? "" : ", ", cmd_names[i].name);
+	}
+	xasprintf(cause, "ambiguous command: %s, could be: %s", cmd_name, s);
+	return (NULL);
 }
 
 char **
@@ -102,10 +206,8 @@ cmd_parse(int argc, char **argv, const char *file, u_int line, char **cause)
 		return (NULL);
 	}
 
-	if ((entry = cmd_find_cmd(argv[0])) == NULL) {
-		xasprintf(cause, "unknown command: %s", argv[0]);
+	if ((entry = cmd_find_cmd(argv[0], cause)) == NULL)
 		return (NULL);
-	}
 
 	args = args_parse(entry->args_template, argc, argv);
 	if (args == NULL)
@@ -115,7 +217,7 @@ cmd_parse(int argc, char **argv, const char *file, u_int line, char **cause)
 	if (entry->args_upper != -1 && args->argc > entry->args_upper)
 		goto usage;
 
-	cmd = xcalloc(1, sizeof *cmd);
+	cmd = pool_get(POOL_CMD);
 	cmd->entry = entry;
 	cmd->args = args;
 
@@ -133,17 +235,17 @@ usage:
 }
 
 void *
-cmd_get_context(struct cmd *cmd)
+cmd_get_context(struct cmd *cmd, struct cmd_q *cmdq)
 {
 	struct args	*args = cmd->args;
-	struct client	*c = NULL;
 
 	/* Context will vary depending on the situation.  In most cases,
 	 * operations will involve a client, although we might be operating on a
 	 * window or something else.
 	 *
-	 * Without a -t present, we assume the currently focused window.  If no
-	 * window is focused, that's an error.
+	 * Without a -t present, we assume the window a binding was pressed in,
+	 * or else the currently focused window.  If there's neither, that's an
+	 * error.
 	 *
 	 * If a -t is given then some possibilities exist:
 	 *
@@ -152,8 +254,11 @@ cmd_get_context(struct cmd *cmd)
 	 *
 	 * If we still can't find the window with -t given, then we error out.
 	 */
-	if (!args_has(args, 't'))
+	if (!args_has(args, 't')) {
+		if (cmdq->client != NULL)
+			return (cmdq->client);
 		return (client_get_current());
+	}
 
 	/* XXX: Handle -t parsing here! */
 
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2013 Thomas Adam <thomas@xteddy.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Routines for resolving colours to pixel values.
+ *
+ * Border colours change on every focus change, so they are resolved once
+ * and cached here rather than asking the server each time.  The cache is
+ * thrown away if the root window's colormap changes.
+ */
+
+#include <ctype.h>
+#include <string.h>
+#include "lswm.h"
+
+static struct {
+	const char	*name;
+	uint32_t	 pixel;
+} colours[NO_OF_BORDERS] = {
+	[FOCUS_BORDER]		= { CONFIG_FOCUS_COLOUR, 0 },
+	[UNFOCUS_BORDER]	= { CONFIG_NFOCUS_COLOUR, 0 },
+	[URGENT_BORDER]		= { CONFIG_URGENT_COLOUR, 0 },
+};
+static bool		 colours_valid;
+static xcb_colormap_t	 colours_cmap;
+
+static xcb_visualtype_t	*colour_find_visual(void);
+static uint32_t		 colour_scale(u_int, uint32_t);
+static int		 colour_parse_hex(const char *, uint32_t *);
+
+static xcb_visualtype_t *
+colour_find_visual(void)
+{
+	xcb_depth_iterator_t	 d_iter;
+	xcb_visualtype_iterator_t v_iter;
+
+	d_iter = xcb_screen_allowed_depths_iterator(current_screen);
+	for (; d_iter.rem; xcb_depth_next(&d_iter)) {
+		v_iter = xcb_depth_visuals_iterator(d_iter.data);
+		for (; v_iter.rem; xcb_visualtype_next(&v_iter)) {
+			if (v_iter.data->visual_id == current_screen->root_visual)
+				return (v_iter.data);
+		}
+	}
+	return (NULL);
+}
+
+/* Fit an 8-bit colour component into the bits of a visual's mask. */
+static uint32_t
+colour_scale(u_int c, uint32_t mask)
+{
+	u_int	 shift = 0, bits = 0;
+
+	if (mask == 0)
+		return (0);
+	while (((mask >> shift) & 1) == 0)
+		shift++;
+	while (((mask >> (shift + bits)) & 1) == 1)
+		bits++;
+
+	if (bits < 8)
+		c >>= 8 - bits;
+	else
+		c <<= bits - 8;
+
+	return ((c << shift) & mask);
+}
+
+/* Turn "#rrggbb" into a pixel directly.  This only works on TrueColor
+ * visuals, where the pixel value is made up from the colour itself.
+ */
+static int
+colour_parse_hex(const char *name, uint32_t *pixel)
+{
+	xcb_visualtype_t	*v;
+	u_int			 r, g, b, i;
+
+	if (name[0] != '#' || strlen(name) != 7)
+		return (-1);
+	for (i = 1; i < 7; i++) {
+		if (!isxdigit((u_char)name[i]))
+			return (-1);
+	}
+
+	if ((v = colour_find_visual()) == NULL ||
+	    v->_class != XCB_VISUAL_CLASS_TRUE_COLOR)
+		return (-1);
+
+	if (sscanf(name + 1, "%2x%2x%2x", &r, &g, &b) != 3)
+		return (-1);
+
+	*pixel = colour_scale(r, v->red_mask) |
+	    colour_scale(g, v->green_mask) |
+	    colour_scale(b, v->blue_mask);
+
+	return (0);
+}
+
+/* Resolve all colours.  Anything which can't be worked out locally is
+ * requested from the server in one go.
+ */
+void
+colour_cache_init(void)
+{
+	xcb_alloc_named_color_cookie_t	 col_ck[NO_OF_BORDERS];
+	xcb_alloc_named_color_reply_t	*col_r;
+	bool				 pending[NO_OF_BORDERS];
+	u_int				 i;
+
+	if (colours_cmap == XCB_NONE)
+		colours_cmap = current_screen->default_colormap;
+
+	for (i = 0; i < NO_OF_BORDERS; i++) {
+		pending[i] = false;
+		if (colour_parse_hex(colours[i].name, &colours[i].pixel) == 0)
+			continue;
+
+		col_ck[i] = xcb_alloc_named_color(dpy, colours_cmap,
+		    strlen(colours[i].name), colours[i].name);
+		pending[i] = true;
+	}
+
+	for (i = 0; i < NO_OF_BORDERS; i++) {
+		if (!pending[i])
+			continue;
+
+		col_r = x_reply(xcb_alloc_named_color_reply, dpy, col_ck[i],
+		    NULL);
+		if (col_r == NULL) {
+			log_fatal("Couldn't get pixel value for colour %s",
+			    colours[i].name);
+		}
+		colours[i].pixel = col_r->pixel;
+		free(col_r);
+	}
+
+	for (i = 0; i < NO_OF_BORDERS; i++) {
+		log_msg("Colour: '%s' is pixel 0x%x", colours[i].name,
+		    colours[i].pixel);
+	}
+	colours_valid = true;
+}
+
+/* Forget all colours; they are looked up again on next use. */
+void
+colour_cache_invalidate(xcb_colormap_t cmap)
+{
+	log_msg("Colormap changed to 0x%x, invalidating colours", cmap);
+
+	if (cmap == XCB_NONE)
+		cmap = current_screen->default_colormap;
+	colours_cmap = cmap;
+	colours_valid = false;
+}
+
+uint32_t
+colour_get_pixel(int type)
+{
+	if (type < 0 || type >= NO_OF_BORDERS)
+		log_fatal("Unknown colour type %d", type);
+
+	if (!colours_valid)
+		colour_cache_init();
+
+	return (colours[type].pixel);
+}
@@ -22,4 +22,23 @@
 #define CONFIG_NFOCUS_COLOUR "green"
 #define CONFIG_URGENT_COLOUR "red"
 
+/* Interactive moves/resizes update the window at most this often (ms). */
+#define CONFIG_DRAG_INTERVAL 16
+/* Ask for PointerMotionHint during a drag, rather than every motion. */
+#define CONFIG_DRAG_MOTION_HINT 0
+
+/* Desktops per monitor.  Each is only created when first used. */
+#define CONFIG_DESKTOPS 10
+
+/* How windows on hidden desktops are hidden: HIDE_UNMAP or HIDE_PARK. */
+#define CONFIG_HIDE_STRATEGY HIDE_UNMAP
+
+/* Use RandR 1.5 monitors, rather than outputs, if the server has them. */
+#define CONFIG_RANDR_MONITORS 1
+/* Wait this long after the last RandR event before acting on it (ms). */
+#define CONFIG_RANDR_DELAY 250
+
+/* How many previous geometries each client remembers. */
+#define CONFIG_GEOMETRY_HISTORY 8
+
 #endif
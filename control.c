@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2013 Thomas Adam <thomas@xteddy.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* The control socket.  Each line written to it is parsed and run as a
+ * command, and answered with "ok" or the reason it failed.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lswm.h"
+
+#define CONTROL_BUF_SIZE 1024
+
+struct control_client {
+	struct event_fd	*efd;
+	char		 buf[CONTROL_BUF_SIZE];
+	size_t		 len;
+};
+
+static int		 control_fd = -1;
+static char		*control_path;
+static struct event_fd	*control_efd;
+
+static int	 control_nonblock(int);
+static void	 control_accept(struct event_fd *, short);
+static void	 control_read(struct event_fd *, short);
+static void	 control_run(struct control_client *, char *);
+static void	 control_reply(struct control_client *, const char *);
+static void	 control_print(struct cmd_q *, const char *);
+static void	 control_client_free(struct control_client *);
+
+static int
+control_nonblock(int fd)
+{
+	int	 flags;
+
+	if ((flags = fcntl(fd, F_GETFL)) == -1 ||
+	    fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+		return (-1);
+	return (fcntl(fd, F_SETFD, FD_CLOEXEC));
+}
+
+/* The default socket is named after the display, in a directory only this
+ * user can get into, as /tmp is open to anyone.  Returns NULL if the
+ * directory can't be made or isn't safe.
+ */
+char *
+control_default_path(void)
+{
+	struct stat	 sb;
+	char		*base, *path, *cp;
+	const char	*display;
+	uid_t		 uid = getuid();
+
+	xasprintf(&base, "/tmp/" PROGNAME "-%ld", (long)uid);
+	if (mkdir(base, S_IRWXU) != 0 && errno != EEXIST)
+		goto fail;
+	if (lstat(base, &sb) != 0)
+		goto fail;
+	if (!S_ISDIR(sb.st_mode)) {
+		errno = ENOTDIR;
+		goto fail;
+	}
+	if (sb.st_uid != uid || (sb.st_mode & (S_IRWXG|S_IRWXO)) != 0) {
+		errno = EACCES;
+		goto fail;
+	}
+
+	if ((display = getenv("DISPLAY")) == NULL || *display == '\0')
+		display = "default";
+	xasprintf(&path, "%s/%s", base, display);
+	for (cp = path + strlen(base) + 1; *cp != '\0'; cp++) {
+		if (*cp == '/')
+			*cp = '_';
+	}
+	free(base);
+	return (path);
+
+fail:
+	log_msg("Couldn't use %s: %s", base, strerror(errno));
+	free(base);
+	return (NULL);
+}
+
+void
+control_init(const char *path)
+{
+	struct sockaddr_un	 sa;
+	struct stat		 sb;
+	mode_t			 mask;
+
+	memset(&sa, 0, sizeof sa);
+	sa.sun_family = AF_UNIX;
+	if (strlcpy(sa.sun_path, path, sizeof sa.sun_path) >=
+	    sizeof sa.sun_path) {
+		log_msg("Control socket path too long: %s", path);
+		return;
+	}
+
+	if ((control_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		log_msg("Couldn't create control socket: %s", strerror(errno));
+		return;
+	}
+
+	/* We already own the display, so a socket left here is stale.  Never
+	 * remove anything else, in case the path was mistyped.
+	 */
+	if (lstat(path, &sb) == 0) {
+		if (!S_ISSOCK(sb.st_mode)) {
+			log_msg("Not using %s: it exists and isn't a socket",
+			    path);
+			close(control_fd);
+			control_fd = -1;
+			return;
+		}
+		unlink(path);
+	}
+
+	mask = umask(S_IXUSR|S_IRWXG|S_IRWXO);
+	if (bind(control_fd, (struct sockaddr *)&sa, sizeof sa) == -1 ||
+	    listen(control_fd, 16) == -1 ||
+	    control_nonblock(control_fd) == -1) {
+		log_msg("Couldn't listen on %s: %s", path, strerror(errno));
+		umask(mask);
+		close(control_fd);
+		control_fd = -1;
+		return;
+	}
+	umask(mask);
+
+	control_path = xstrdup(path);
+	control_efd = event_add_fd(control_fd, POLLIN, control_accept, NULL);
+
+	log_msg("Control socket listening on %s", control_path);
+}
+
+void
+control_close(void)
+{
+	if (control_fd == -1)
+		return;
+
+	event_del_fd(control_efd);
+	close(control_fd);
+	unlink(control_path);
+	free(control_path);
+
+	control_fd = -1;
+	control_path = NULL;
+}
+
+static void
+control_accept(unused struct event_fd *efd, unused short revents)
+{
+	struct control_client	*cc;
+	int			 fd;
+
+	if ((fd = accept(control_fd, NULL, NULL)) == -1) {
+		if (errno != EAGAIN && errno != EINTR)
+			log_msg("accept failed: %s", strerror(errno));
+		return;
+	}
+	if (control_nonblock(fd) == -1) {
+		close(fd);
+		return;
+	}
+
+	cc = xcalloc(1, sizeof *cc);
+	cc->efd = event_add_fd(fd, POLLIN, control_read, cc);
+}
+
+static void
+control_read(struct event_fd *efd, unused short revents)
+{
+	struct control_client	*cc = efd->arg;
+	char			*line, *eol;
+	ssize_t			 n;
+
+	n = read(efd->fd, cc->buf + cc->len, sizeof cc->buf - cc->len - 1);
+	if (n == -1 && (errno == EAGAIN || errno == EINTR))
+		return;
+	if (n <= 0) {
+		control_client_free(cc);
+		return;
+	}
+	cc->len += n;
+	cc->buf[cc->len] = '\0';
+
+	line = cc->buf;
+	while ((eol = strchr(line, '\n')) != NULL) {
+		*eol = '\0';
+		control_run(cc, line);
+		line = eol + 1;
+	}
+	cc->len -= line - cc->buf;
+	memmove(cc->buf, line, cc->len);
+
+	if (cc->len == sizeof cc->buf - 1) {
+		control_reply(cc, "error: line too long");
+		control_client_free(cc);
+	}
+}
+
+static void
+control_run(struct control_client *cc, char *line)
+{
+	struct cmd_list	*cmdlist;
+	struct cmd_q	*cmdq;
+	char		*cause, *msg;
+	int		 failed = 0;
+	u_int		 errors = 0;
+
+	if (cmd_string_parse(line, &cmdlist, "control", 0, &cause) != 0) {
+		xasprintf(&msg, "error: %s", cause != NULL ? cause : "parse");
+		control_reply(cc, msg);
+		free(msg);
+		free(cause);
+		return;
+	}
+
+	if (cmdlist != NULL) {
+		cmdq = cmdq_new();
+		cmdq->printfn = control_print;
+		cmdq->data = cc;
+		cmdq_run(cmdq, cmdlist);
+		failed = cmdq->failed;
+		errors = cmdq->errors;
+		cmdq_free(cmdq);
+		cmd_list_free(cmdlist);
+	}
+
+	/* Errors will have been sent as they happened. */
+	if (!failed)
+		control_reply(cc, "ok");
+	else if (errors == 0)
+		control_reply(cc, "error: command failed");
+}
+
+/* Replies are short, so a full socket buffer just loses them. */
+static void
+control_reply(struct control_client *cc, const char *msg)
+{
+	(void)write(cc->efd->fd, msg, strlen(msg));
+	(void)write(cc->efd->fd, "\n", 1);
+}
+
+/* Send command output back to whoever asked for it. */
+static void
+control_print(struct cmd_q *cmdq, const char *msg)
+{
+	control_reply(cmdq->data, msg);
+}
+
+static void
+control_client_free(struct control_client *cc)
+{
+	close(cc->efd->fd);
+	event_del_fd(cc->efd);
+	free(cc);
+}
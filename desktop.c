@@ -19,6 +19,26 @@
 #include <string.h>
 #include "lswm.h"
 
+/* How many desktops have been created, across all monitors. */
+static u_int	 desktops_count;
+
+/* The desktop last switched to, or holding the current client. */
+static struct desktop	*cur_desktop;
+
+/* Time from a switch starting to its requests being flushed, in buckets of
+ * powers of two microseconds.
+ */
+#define SWITCH_BUCKETS 20
+static struct {
+	uint64_t	 start;
+	bool		 pending;
+
+	u_int		 buckets[SWITCH_BUCKETS];
+	u_int		 count;
+	uint64_t	 total;
+	uint64_t	 max;
+} switch_times;
+
 struct desktop *
 desktop_create(void)
 {
@@ -28,25 +48,63 @@ desktop_create(void)
 	memset(d, 0, sizeof *d);
 
 	TAILQ_INIT(&d->clients_q);
+	d->hide = -1;
 
 	d->name = NULL;
 
 	return (d);
 }
 
+/* Free a desktop, which must have no clients left on it. */
+void
+desktop_destroy(struct desktop *d)
+{
+	struct monitor	*m = d->monitor;
+
+	if (!TAILQ_EMPTY(&d->clients_q))
+		log_fatal("Desktop '%s' still has clients", d->name);
+
+	if (m != NULL) {
+		TAILQ_REMOVE(&m->desktops_q, d, entry);
+		m->desktops[d->idx] = NULL;
+		m->ndesktops--;
+		if (m->active_desktop == d)
+			m->active_desktop = NULL;
+		desktops_count--;
+	}
+	if (cur_desktop == d)
+		cur_desktop = NULL;
+
+	free(d->name);
+	free(d);
+}
+
 void
 add_desktop_to_monitor(struct monitor *m, struct desktop *d)
 {
+	struct desktop	*next = NULL;
+	u_int		 i;
+
 	if (m == NULL) {
 		log_fatal("Can't add desktop '%s' to nonexistent monitor",
 			  d->name);
 	}
+	if (d->idx >= CONFIG_DESKTOPS || m->desktops[d->idx] != NULL)
+		log_fatal("Can't add desktop '%s' as number %u", d->name, d->idx);
 
-	if (TAILQ_EMPTY(&m->desktops_q))
-		TAILQ_INSERT_HEAD(&m->desktops_q, d, entry);
+	/* Keep the list in the same order as the table. */
+	for (i = d->idx + 1; i < CONFIG_DESKTOPS && next == NULL; i++)
+		next = m->desktops[i];
+	if (next != NULL)
+		TAILQ_INSERT_BEFORE(next, d, entry);
 	else
 		TAILQ_INSERT_TAIL(&m->desktops_q, d, entry);
 
+	m->desktops[d->idx] = d;
+	m->ndesktops++;
+	d->monitor = m;
+	desktops_count++;
+
 	log_msg("Added desktop: '%s' to monitor: '%s'", d->name, m->name);
 }
 
@@ -60,29 +118,162 @@ desktop_set_name(struct desktop *d, const char *name)
 	d->name = strdup(name);
 }
 
-void
-desktop_setup(struct monitor *m, const char *name)
+/* Get a monitor's desktop by number, creating it the first time it is
+ * asked for.
+ */
+struct desktop *
+desktop_get(struct monitor *m, u_int idx)
 {
 	struct desktop	*d;
+	char		*name;
+
+	if (idx >= CONFIG_DESKTOPS)
+		return (NULL);
+	if ((d = m->desktops[idx]) != NULL)
+		return (d);
 
 	d = desktop_create();
+	d->idx = idx;
+	xasprintf(&name, "%s:%u", m->name, idx);
 	desktop_set_name(d, name);
+	free(name);
 	add_desktop_to_monitor(m, d);
+
+	ewmh_update_desktops();
+
+	return (d);
 }
 
-inline int
+u_int
 desktop_count_all_desktops(void)
+{
+	return (desktops_count);
+}
+
+/* The current desktop is the one holding the current client, or else the
+ * one displayed on the first monitor.
+ */
+struct desktop *
+desktop_get_current(void)
 {
 	struct monitor	*m;
-	struct desktop	*d;
-	int		 c;
 
-	c = 0;
-	TAILQ_FOREACH(m, &monitor_q, entry) {
-		TAILQ_FOREACH(d, &m->desktops_q, entry) {
-			c++;
+	if (cur_desktop != NULL)
+		return (cur_desktop);
+	if ((m = TAILQ_FIRST(&monitor_q)) != NULL)
+		return (m->active_desktop);
+	return (NULL);
+}
+
+void
+desktop_set_current(struct desktop *d)
+{
+	if (d == cur_desktop)
+		return;
+	cur_desktop = d;
+	ewmh_set_current_desktop();
+}
+
+/* Show a different desktop on a monitor.  Everything is sent in one go:
+ * the new desktop's clients are shown before the old desktop's are hidden
+ * so the root never shows through, and is flushed along with the EWMH
+ * updates at the end of this trip round the loop.
+ */
+void
+desktop_show(struct monitor *m, struct desktop *new)
+{
+	struct desktop	*old = m->active_desktop;
+	struct client	*c;
+	u_int		 shown = 0, hidden = 0;
+
+	if (new == old)
+		return;
+
+	TAILQ_FOREACH(c, &new->clients_q, entry) {
+		client_show(c);
+		shown++;
+	}
+	if (old != NULL) {
+		TAILQ_FOREACH(c, &old->clients_q, entry) {
+			client_hide(c);
+			hidden++;
 		}
 	}
 
-	return (c);
+	m->active_desktop = new;
+
+	log_msg("Showing desktop %s on %s: %u shown, %u hidden", new->name,
+	    m->name, shown, hidden);
+}
+
+/* Switch a monitor to another desktop as the user asked, which becomes the
+ * current one.  The time taken is recorded.
+ */
+void
+desktop_switch(struct monitor *m, u_int idx)
+{
+	struct desktop	*old, *new;
+	struct client	*c;
+
+	if ((new = desktop_get(m, idx)) == NULL)
+		return;
+	old = m->active_desktop;
+	if (new == old) {
+		desktop_set_current(new);
+		return;
+	}
+
+	switch_times.start = event_now();
+	switch_times.pending = true;
+
+	desktop_show(m, new);
+
+	/* The current client only stays so if it's still visible.  Its
+	 * replacement gets the focus in the same flush as the switch.
+	 */
+	c = client_get_current();
+	if (c == NULL || c->desktop == old)
+		client_set_current(TAILQ_LAST(&new->clients_q, clients));
+	desktop_set_current(new);
+}
+
+/* Called once output has been flushed, to finish timing a switch. */
+void
+desktop_switch_flushed(void)
+{
+	uint64_t	 us;
+	u_int		 b;
+
+	if (!switch_times.pending)
+		return;
+	switch_times.pending = false;
+
+	us = event_now() - switch_times.start;
+	for (b = 0; b < SWITCH_BUCKETS - 1 && (1ULL << b) <= us; b++)
+		;
+	switch_times.buckets[b]++;
+	switch_times.count++;
+	switch_times.total += us;
+	if (us > switch_times.max)
+		switch_times.max = us;
+}
+
+void
+desktop_switch_summary(struct cmd_q *cmdq)
+{
+	u_int		 b;
+
+	cmdq_print(cmdq, "%u switches, mean %llu us, max %llu us",
+	    switch_times.count, (unsigned long long)(switch_times.count == 0 ?
+	    0 : switch_times.total / switch_times.count),
+	    (unsigned long long)switch_times.max);
+
+	for (b = 0; b < SWITCH_BUCKETS; b++) {
+		if (switch_times.buckets[b] == 0)
+			continue;
+		cmdq_print(cmdq, "%10s %8llu us: %u",
+		    b == SWITCH_BUCKETS - 1 ? ">=" : "<",
+		    b == SWITCH_BUCKETS - 1 ? 1ULL << (b - 1) : 1ULL << b,
+		    switch_times.buckets[b]);
+	}
 }
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2013 Thomas Adam <thomas@xteddy.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Routines for moving and resizing clients with the pointer.
+ *
+ * Motion is only selected while a drag is in progress, through an active
+ * grab on the root window.  The window itself is reconfigured at most
+ * once every CONFIG_DRAG_INTERVAL milliseconds, with whatever the latest
+ * pointer position is at the time.
+ */
+
+#include <string.h>
+#include "lswm.h"
+
+static struct {
+	struct client		*c;
+	int			 mode;
+
+	/* Where the pointer and the window started. */
+	int			 start_x;
+	int			 start_y;
+	struct rectangle	 start;
+
+	/* The latest pointer position, and whether it's been applied. */
+	int			 x;
+	int			 y;
+	bool			 pending;
+
+	struct timer		*timer;
+} drag;
+
+static void	 drag_apply(void);
+static void	 drag_tick(void *);
+
+bool
+drag_active(void)
+{
+	return (drag.c != NULL);
+}
+
+void
+drag_start(struct client *c, int mode)
+{
+	xcb_query_pointer_reply_t	*qp;
+	xcb_grab_pointer_reply_t	*gp;
+	uint16_t			 mask;
+
+	if (drag_active() || c == NULL)
+		return;
+
+	if ((qp = x_reply(xcb_query_pointer_reply, dpy,
+	    xcb_query_pointer(dpy, current_screen->root), NULL)) == NULL)
+		return;
+
+	mask = XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE |
+	    XCB_EVENT_MASK_POINTER_MOTION;
+	if (CONFIG_DRAG_MOTION_HINT)
+		mask |= XCB_EVENT_MASK_POINTER_MOTION_HINT;
+
+	gp = x_reply(xcb_grab_pointer_reply, dpy, xcb_grab_pointer(dpy, 0,
+	    current_screen->root, mask, XCB_GRAB_MODE_ASYNC,
+	    XCB_GRAB_MODE_ASYNC, XCB_NONE, XCB_NONE, XCB_CURRENT_TIME), NULL);
+	if (gp == NULL || gp->status != XCB_GRAB_STATUS_SUCCESS) {
+		log_msg("Couldn't grab the pointer to drag 0x%x", c->win);
+		free(gp);
+		free(qp);
+		return;
+	}
+	free(gp);
+
+	/* So the drag can be undone.  Moving a maximised window leaves it
+	 * no longer maximised.
+	 */
+	client_push_geometry(c);
+	c->geom.state = NORMAL;
+	ewmh_set_wm_state(c);
+	client_raise(c);
+
+	drag.c = c;
+	drag.mode = mode;
+	drag.start_x = drag.x = qp->root_x;
+	drag.start_y = drag.y = qp->root_y;
+	drag.start = c->geom.coords;
+	drag.pending = false;
+	drag.timer = NULL;
+
+	free(qp);
+
+	log_msg("Drag of 0x%x started at %d,%d", c->win, drag.x, drag.y);
+}
+
+void
+drag_motion(xcb_motion_notify_event_t *ev)
+{
+	xcb_query_pointer_reply_t	*qp;
+
+	if (!drag_active())
+		return;
+
+	drag.x = ev->root_x;
+	drag.y = ev->root_y;
+	drag.pending = true;
+
+	/* With motion hints, the server sends nothing more until it's asked
+	 * where the pointer is.  Only ask once the window has caught up.
+	 */
+	if (drag.timer != NULL)
+		return;
+
+	if (ev->detail == XCB_MOTION_HINT) {
+		if ((qp = x_reply(xcb_query_pointer_reply, dpy,
+		    xcb_query_pointer(dpy, current_screen->root),
+		    NULL)) != NULL) {
+			drag.x = qp->root_x;
+			drag.y = qp->root_y;
+			free(qp);
+		}
+	}
+
+	drag_apply();
+	drag.timer = timer_add(CONFIG_DRAG_INTERVAL, drag_tick, NULL);
+}
+
+static void
+drag_tick(unused void *arg)
+{
+	xcb_query_pointer_reply_t	*qp;
+
+	drag.timer = NULL;
+	if (!drag.pending)
+		return;
+
+	if (CONFIG_DRAG_MOTION_HINT) {
+		if ((qp = x_reply(xcb_query_pointer_reply, dpy,
+		    xcb_query_pointer(dpy, current_screen->root),
+		    NULL)) != NULL) {
+			drag.x = qp->root_x;
+			drag.y = qp->root_y;
+			free(qp);
+		}
+	}
+
+	drag_apply();
+	drag.timer = timer_add(CONFIG_DRAG_INTERVAL, drag_tick, NULL);
+}
+
+static void
+drag_apply(void)
+{
+	struct client		*c = drag.c;
+	struct rectangle	*r = &c->geom.coords;
+	uint32_t		 values[2];
+	uint16_t		 mask;
+	int			 dx, dy, w, h;
+
+	drag.pending = false;
+
+	dx = drag.x - drag.start_x;
+	dy = drag.y - drag.start_y;
+
+	if (drag.mode == DRAG_MOVE) {
+		if (r->x == drag.start.x + dx && r->y == drag.start.y + dy)
+			return;
+		r->x = drag.start.x + dx;
+		r->y = drag.start.y + dy;
+
+		mask = XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y;
+		values[0] = r->x;
+		values[1] = r->y;
+	} else {
+		/* Keep to the client's size increments and limits. */
+		w = MAX(1, drag.start.w + dx);
+		h = MAX(1, drag.start.h + dy);
+		w = MAX(w, c->hints.min_w);
+		h = MAX(h, c->hints.min_h);
+		if (c->hints.max_w > 0)
+			w = MIN(w, c->hints.max_w);
+		if (c->hints.max_h > 0)
+			h = MIN(h, c->hints.max_h);
+		if (w > c->hints.base_w)
+			w -= (w - c->hints.base_w) % MAX(1, c->hints.inc_w);
+		if (h > c->hints.base_h)
+			h -= (h - c->hints.base_h) % MAX(1, c->hints.inc_h);
+
+		if (r->w == w && r->h == h)
+			return;
+		r->w = w;
+		r->h = h;
+
+		mask = XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT;
+		values[0] = r->w;
+		values[1] = r->h;
+	}
+
+	xcb_configure_window(dpy, c->win, mask, values);
+}
+
+/* The client being dragged has gone away; stop without touching it. */
+void
+drag_cancel(struct client *c)
+{
+	if (drag.c != c)
+		return;
+
+	if (drag.timer != NULL)
+		timer_del(drag.timer);
+	drag.timer = NULL;
+
+	xcb_ungrab_pointer(dpy, XCB_CURRENT_TIME);
+	drag.c = NULL;
+}
+
+void
+drag_end(void)
+{
+	struct geometry	*prev;
+
+	if (!drag_active())
+		return;
+
+	if (drag.timer != NULL)
+		timer_del(drag.timer);
+	drag.timer = NULL;
+
+	/* Make sure the final position isn't lost to the throttling. */
+	if (drag.pending)
+		drag_apply();
+
+	xcb_ungrab_pointer(dpy, XCB_CURRENT_TIME);
+
+	/* Don't fill the history with drags which went nowhere. */
+	prev = client_peek_geometry(drag.c);
+	if (prev != NULL && memcmp(&prev->coords, &drag.c->geom.coords,
+	    sizeof prev->coords) == 0) {
+		drag.c->geom.state = prev->state;
+		ewmh_set_wm_state(drag.c);
+		client_pop_geometry(drag.c, NULL);
+	}
+
+	log_msg("Drag of 0x%x finished at %dx%d+%d+%d", drag.c->win,
+	    drag.c->geom.coords.w, drag.c->geom.coords.h,
+	    drag.c->geom.coords.x, drag.c->geom.coords.y);
+
+	drag.c = NULL;
+}
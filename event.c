@@ -14,45 +14,153 @@
  * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-/* Routines to handle the main event loop. */
+/* Routines to handle the main event loop.
+ *
+ * The loop polls the X connection together with any timers, a pipe
+ * written to by signal handlers and other descriptors (such as the
+ * control socket), so that lswm can do more than wait for X events.
+ */
 
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include <xcb/xcb_keysyms.h>
 #include <X11/Xlib.h>
 #include <X11/keysymdef.h>
 #include "lswm.h"
 
-#define CLEANMASK(mask) (mask & ~(XCB_MOD_MASK_LOCK))
-
-static void	 (*events[XCB_NO_OPERATION])(xcb_generic_event_t *);
+static void	 (*events[XCB_NO_OPERATION + 1])(xcb_generic_event_t *);
 static void	 register_events(void);
 
+/* Timers, in order of expiry. */
+static struct timers	 timers_q = TAILQ_HEAD_INITIALIZER(timers_q);
+
+/* Descriptors polled as well as the X connection. */
+static struct event_fds	 event_fds_q = TAILQ_HEAD_INITIALIZER(event_fds_q);
+
+/* Signal handlers write the signal number down this pipe. */
+static int			 signal_pipe[2] = { -1, -1 };
+static volatile sig_atomic_t	 event_done;
+
+/* Whether requests may have been queued since output was last flushed.
+ * Requests are only made in response to something happening, so this is
+ * set whenever an event, timer or descriptor is handled, and the output
+ * is flushed once, just before the loop blocks.  Anything which needs a
+ * reply has xcb flush for it.
+ */
+static bool			 event_output_dirty = true;
+static u_int			 event_handled;
+
+static void	 signals_init(void);
+static void	 signal_handler(int);
+static void	 signal_read(struct event_fd *, short);
+static void	 event_set_nonblock(int);
+static void	 event_dispatch(xcb_generic_event_t *);
+static u_int	 event_dispatch_x(int);
+static struct client *event_find_client(xcb_window_t, xcb_window_t);
+static void	 timers_run(void);
+static int	 timers_next(void);
+
+static void	 run_binding(struct binding *, struct client *);
 static void	 handle_key_press(xcb_generic_event_t *);
 static void	 handle_button_press(xcb_generic_event_t *);
+static void	 handle_button_release(xcb_generic_event_t *);
 static void	 handle_motion_notify(xcb_generic_event_t *);
 static void	 handle_map_request(xcb_generic_event_t *);
+static void	 handle_destroy_notify(xcb_generic_event_t *);
+static void	 handle_colormap_notify(xcb_generic_event_t *);
+static void	 handle_mapping_notify(xcb_generic_event_t *);
 
 static void
 register_events(void)
 {
-	memset(events, 0, sizeof *events);
+	memset(events, 0, sizeof events);
 
 	events[XCB_KEY_PRESS] = handle_key_press;
 	events[XCB_BUTTON_PRESS] = handle_button_press;
+	events[XCB_BUTTON_RELEASE] = handle_button_release;
 	events[XCB_MOTION_NOTIFY] = handle_motion_notify;
-	events[XCB_MAP_NOTIFY] = handle_map_request;
+	events[XCB_MAP_REQUEST] = handle_map_request;
+	events[XCB_DESTROY_NOTIFY] = handle_destroy_notify;
+	events[XCB_COLORMAP_NOTIFY] = handle_colormap_notify;
+	events[XCB_MAPPING_NOTIFY] = handle_mapping_notify;
+
+	/* RandR events are numbered from where the extension says. */
+	if (randr_start != 0 &&
+	    randr_start + XCB_RANDR_NOTIFY <= XCB_NO_OPERATION) {
+		events[randr_start + XCB_RANDR_SCREEN_CHANGE_NOTIFY] =
+		    randr_handle_event;
+		events[randr_start + XCB_RANDR_NOTIFY] = randr_handle_event;
+	}
 }
 
 static void
 handle_map_request(xcb_generic_event_t *ev)
 {
-	return;
+	xcb_map_request_event_t	*mr_ev;
+	struct client		*c;
+
+	mr_ev = (xcb_map_request_event_t *)ev;
+
+	if (client_find_by_window(mr_ev->window) == NULL) {
+		c = client_create(mr_ev->window);
+		if (client_manage_client(c, NULL, true) != 0) {
+			pool_put(POOL_CLIENT, c);
+			return;
+		}
+	}
+	xcb_map_window(dpy, mr_ev->window);
+}
+
+static void
+handle_destroy_notify(xcb_generic_event_t *ev)
+{
+	xcb_destroy_notify_event_t	*dn_ev = (xcb_destroy_notify_event_t *)ev;
+	struct client			*c;
+
+	if ((c = client_find_by_window(dn_ev->window)) == NULL)
+		return;
+
+	client_unmanage(c);
+}
+
+static void
+handle_colormap_notify(xcb_generic_event_t *ev)
+{
+	xcb_colormap_notify_event_t	*cn_ev = (xcb_colormap_notify_event_t *)ev;
+
+	/* Only a change of the root's colormap affects border colours;
+	 * installing or uninstalling a colormap leaves pixels alone.
+	 */
+	if (cn_ev->window != current_screen->root || !cn_ev->_new)
+		return;
+
+	colour_cache_invalidate(cn_ev->colormap);
+}
+
+static void
+handle_mapping_notify(xcb_generic_event_t *ev)
+{
+	xcb_mapping_notify_event_t	*mn_ev = (xcb_mapping_notify_event_t *)ev;
+
+	/* Changes to the XKB map arrive here as well, as core events. */
+	if (mn_ev->request == XCB_MAPPING_POINTER)
+		return;
+
+	keymap_update();
+	regrab_all_bindings();
 }
 
 static void
 handle_motion_notify(xcb_generic_event_t *ev)
 {
-	return;
+	drag_motion((xcb_motion_notify_event_t *)ev);
 }
 
 static void
@@ -61,6 +169,16 @@ handle_button_press(xcb_generic_event_t *ev)
 	xcb_button_press_event_t	*bp_ev = (xcb_button_press_event_t *)ev;
 
 	log_msg("BUTTON PRESS: %d, state: %d", bp_ev->detail, bp_ev->state);
+
+	/* A drag started from the keyboard finishes on a click. */
+	if (drag_active()) {
+		drag_end();
+		return;
+	}
+
+	run_binding(binding_find(TYPE_MOUSE, bp_ev->detail,
+	    keymap_clean_mask(bp_ev->state)),
+	    event_find_client(bp_ev->event, bp_ev->child));
 }
 
 static void
@@ -68,46 +186,358 @@ handle_key_press(xcb_generic_event_t *ev)
 {
 	xcb_key_press_event_t	*kp_ev = (xcb_key_press_event_t *)ev;
 	xcb_keysym_t		 keysym;
-	xcb_key_symbols_t       *all_keysyms;
-	struct binding		*kb;
-	u_int			 clean_mask, mod_clean;
-	struct cmd_q		*cmdq = cmdq_new();
+	u_int			 clean_mask;
 
-	if ((all_keysyms = xcb_key_symbols_alloc(dpy)) == NULL)
-		log_fatal("Couldn't find keysyms...");
+	keysym = keymap_keysym(kp_ev->detail);
+	clean_mask = keymap_clean_mask(kp_ev->state);
 
-	keysym = xcb_key_press_lookup_keysym(all_keysyms, kp_ev, 0);
-	clean_mask = kp_ev->state & ~(XCB_MOD_MASK_LOCK);
+	log_msg("KP: %d, M: %d (%d)", keysym, clean_mask, kp_ev->state);
 
-	TAILQ_FOREACH(kb, &global_bindings, entry) {
-		if (kb->type != TYPE_KEY)
-			continue;
+	run_binding(binding_find(TYPE_KEY, keysym, clean_mask),
+	    event_find_client(kp_ev->event, kp_ev->child));
+}
+
+static void
+handle_button_release(unused xcb_generic_event_t *ev)
+{
+	drag_end();
+}
+
+/* Bindings act on the client the event happened in, which needn't be the
+ * focused one.  Grabs on the root report the client's window as the child.
+ */
+static struct client *
+event_find_client(xcb_window_t event, xcb_window_t child)
+{
+	if (event == current_screen->root)
+		event = child;
+	return (client_find_by_window(event));
+}
+
+static void
+run_binding(struct binding *kb, struct client *c)
+{
+	struct cmd_q	*cmdq;
+
+	if (kb == NULL)
+		return;
+
+	cmdq = cmdq_new();
+	cmdq->client = c;
+	cmdq_run(cmdq, kb->cmd_list);
+	cmdq_free(cmdq);
+}
+
+/* Current monotonic time in microseconds. */
+uint64_t
+event_now(void)
+{
+	struct timespec	 ts;
 
-		log_msg("Found a key press...");
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		log_fatal("clock_gettime failed");
+	return ((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/* Call cb with arg once msec milliseconds have passed.  The callback may
+ * wait on replies.
+ */
+struct timer *
+timer_add(u_int msec, void (*cb)(void *), void *arg)
+{
+	struct timer	*t, *t1;
+
+	t = xcalloc(1, sizeof *t);
+	t->expiry = event_now() + (uint64_t)msec * 1000;
+	t->cb = cb;
+	t->arg = arg;
 
-		mod_clean = kb->modifier & ~(XCB_MOD_MASK_LOCK);
-		log_msg("KP: %d, K: %d, M: %d (%d)", keysym, kb->p.key,
-				mod_clean, clean_mask);
-		if (keysym == kb->p.key && kp_ev->state == clean_mask) {
-			cmdq_run(cmdq, kb->cmd_list);
+	TAILQ_FOREACH(t1, &timers_q, entry) {
+		if (t1->expiry > t->expiry) {
+			TAILQ_INSERT_BEFORE(t1, t, entry);
+			return (t);
 		}
 	}
+	TAILQ_INSERT_TAIL(&timers_q, t, entry);
+
+	return (t);
+}
+
+void
+timer_del(struct timer *t)
+{
+	TAILQ_REMOVE(&timers_q, t, entry);
+	free(t);
+}
+
+static void
+timers_run(void)
+{
+	struct timer	*t;
+	uint64_t	 now;
+
+	now = event_now();
+	while ((t = TAILQ_FIRST(&timers_q)) != NULL && t->expiry <= now) {
+		TAILQ_REMOVE(&timers_q, t, entry);
+		event_output_dirty = true;
+		t->cb(t->arg);
+		free(t);
+	}
+}
+
+/* Milliseconds until the next timer expires, or -1 to wait forever. */
+static int
+timers_next(void)
+{
+	struct timer	*t;
+	uint64_t	 now;
+
+	if ((t = TAILQ_FIRST(&timers_q)) == NULL)
+		return (-1);
+
+	now = event_now();
+	if (t->expiry <= now)
+		return (0);
+	return ((t->expiry - now + 999) / 1000);
+}
+
+/* Poll fd for events, calling cb with what happened. */
+struct event_fd *
+event_add_fd(int fd, short ev, void (*cb)(struct event_fd *, short),
+    void *arg)
+{
+	struct event_fd	*efd;
+
+	efd = xcalloc(1, sizeof *efd);
+	efd->fd = fd;
+	efd->events = ev;
+	efd->idx = -1;
+	efd->cb = cb;
+	efd->arg = arg;
+
+	TAILQ_INSERT_TAIL(&event_fds_q, efd, entry);
+
+	return (efd);
+}
+
+/* Stop polling a descriptor.  The descriptor itself isn't closed. */
+void
+event_del_fd(struct event_fd *efd)
+{
+	TAILQ_REMOVE(&event_fds_q, efd, entry);
+	free(efd);
+}
+
+static void
+event_set_nonblock(int fd)
+{
+	int	 flags;
+
+	if ((flags = fcntl(fd, F_GETFL)) == -1 ||
+	    fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+		log_fatal("fcntl failed: %s", strerror(errno));
+	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
+		log_fatal("fcntl failed: %s", strerror(errno));
+}
+
+static void
+signal_handler(int sig)
+{
+	u_char	 c = sig;
+	int	 saved_errno = errno;
+
+	(void)write(signal_pipe[1], &c, 1);
+	errno = saved_errno;
+}
+
+static void
+signals_init(void)
+{
+	struct sigaction	 sa;
+
+	if (pipe(signal_pipe) != 0)
+		log_fatal("pipe failed: %s", strerror(errno));
+	event_set_nonblock(signal_pipe[0]);
+	event_set_nonblock(signal_pipe[1]);
+
+	memset(&sa, 0, sizeof sa);
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+
+	sa.sa_handler = signal_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+	sigaction(SIGCHLD, &sa, NULL);
+
+	event_add_fd(signal_pipe[0], POLLIN, signal_read, NULL);
+}
+
+static void
+signal_read(struct event_fd *efd, unused short revents)
+{
+	u_char	 c;
+
+	while (read(efd->fd, &c, 1) == 1) {
+		switch (c) {
+		case SIGINT:
+		case SIGTERM:
+			log_msg("Got signal %d, exiting", c);
+			event_done = 1;
+			break;
+		case SIGCHLD:
+			while (waitpid(-1, NULL, WNOHANG) > 0)
+				;
+			break;
+		default:
+			log_msg("Ignoring signal %d", c);
+			break;
+		}
+	}
+}
+
+static void
+event_dispatch(xcb_generic_event_t *ev)
+{
+	u_int	 rt;
+
+	rt = ev->response_type & ~0x80;
+
+	if (events[rt] != NULL) {
+		events[rt](ev);
+		event_output_dirty = true;
+		event_handled++;
+	}
+	free(ev);
+}
+
+/* Handle every X event we have, without blocking for more.  If queued is
+ * set, only look at those xcb has already read.  Runs of MotionNotify for
+ * the same window are squashed into the last one, since only the latest
+ * pointer position is of any interest.  Returns the number of events seen.
+ */
+static u_int
+event_dispatch_x(int queued)
+{
+	xcb_generic_event_t		*ev;
+	xcb_motion_notify_event_t	*motion = NULL;
+	u_int				 squashed = 0, n = 0;
+
+	for (;;) {
+		if (queued)
+			ev = xcb_poll_for_queued_event(dpy);
+		else
+			ev = xcb_poll_for_event(dpy);
+		if (ev == NULL)
+			break;
+		n++;
+
+		if ((ev->response_type & ~0x80) == XCB_MOTION_NOTIFY) {
+			if (motion != NULL && motion->event ==
+			    ((xcb_motion_notify_event_t *)ev)->event) {
+				free(motion);
+				squashed++;
+			} else if (motion != NULL)
+				event_dispatch((xcb_generic_event_t *)motion);
+			motion = (xcb_motion_notify_event_t *)ev;
+			continue;
+		}
+
+		if (motion != NULL) {
+			event_dispatch((xcb_generic_event_t *)motion);
+			motion = NULL;
+		}
+		event_dispatch(ev);
+	}
+	if (motion != NULL)
+		event_dispatch((xcb_generic_event_t *)motion);
+
+	if (squashed > 0)
+		log_msg("Squashed %u motion events", squashed);
+	return (n);
 }
 
 void
 event_loop(void)
 {
-	xcb_generic_event_t	*ev;
-	u_int			 rt;
+	struct pollfd		*pfds = NULL;
+	struct event_fd		*efd, *efd1;
+	u_int			 npfds, i;
+	int			 timeout;
+	short			 revents;
 
 	register_events();
+	signals_init();
 
-	while ((ev = xcb_wait_for_event(dpy)) != NULL) {
-		rt = ev->response_type & ~0x80;
+	while (!event_done) {
+		/* Events can be queued by xcb while waiting on a reply, so
+		 * look for some whether or not the descriptor was readable.
+		 */
+		event_dispatch_x(0);
+		if (xcb_connection_has_error(dpy)) {
+			log_msg("Lost connection to the X server");
+			break;
+		}
 
-		if (events[rt] != NULL)
-			events[rt](ev);
-		free(ev);
+		timers_run();
+		if (event_done)
+			break;
+
+		if (event_output_dirty) {
+			ewmh_flush();
+			xcb_flush(dpy);
+			desktop_switch_flushed();
+			event_output_dirty = false;
+			log_msg("Flushed output once for %u event(s)",
+			    event_handled);
+			event_handled = 0;
+		}
+
+		/* Timers and the flush may also have waited on replies.  Events
+		 * read meanwhile won't make the descriptor readable, so go
+		 * round again rather than sleeping on them.
+		 */
+		if (event_dispatch_x(1) != 0)
+			continue;
+
+		npfds = 1;
+		TAILQ_FOREACH(efd, &event_fds_q, entry)
+			npfds++;
+		pfds = xrealloc(pfds, npfds, sizeof *pfds);
+
+		pfds[0].fd = xcb_get_file_descriptor(dpy);
+		pfds[0].events = POLLIN;
+		pfds[0].revents = 0;
+		i = 1;
+		TAILQ_FOREACH(efd, &event_fds_q, entry) {
+			efd->idx = i;
+			pfds[i].fd = efd->fd;
+			pfds[i].events = efd->events;
+			pfds[i].revents = 0;
+			i++;
+		}
+
+		timeout = timers_next();
+		if (poll(pfds, npfds, timeout) == -1) {
+			if (errno == EINTR)
+				continue;
+			log_fatal("poll failed: %s", strerror(errno));
+		}
+
+		/* A callback may remove its own descriptor (but no other),
+		 * or add new ones which haven't been polled yet.
+		 */
+		TAILQ_FOREACH_SAFE(efd, &event_fds_q, entry, efd1) {
+			if (efd->idx == -1 || pfds[efd->idx].revents == 0)
+				continue;
+			revents = pfds[efd->idx].revents;
+			efd->idx = -1;
+			efd->cb(efd, revents);
+			event_output_dirty = true;
+		}
 	}
+	free(pfds);
 }
-
@@ -20,61 +20,124 @@
 #include <xcb/xcb_atom.h>
 #include "lswm.h"
 
-/* Client-specific atoms, which aren't initialised by the EWMH API. */
-struct x_atoms	 cwmh_atoms[] = {
-	{ "WM_PROTOCOLS",			XCB_ATOM_NONE },
-	{ "_MOTIF_WM_HINTS",			XCB_ATOM_NONE },
-	{ "WM_STATE",				XCB_ATOM_NONE },
-	{ "WM_CHANGE_STATE",			XCB_ATOM_NONE },
-	{ "WM_DELETE_WINDOW",			XCB_ATOM_NONE },
-	{ "WM_TAKE_FOCUS",			XCB_ATOM_NONE }
+/* A list of windows held in a root window property.  Windows are only ever
+ * appended to the end of the property, unless one is removed or moved,
+ * when the whole property has to be rewritten.
+ */
+struct ewmh_window_list {
+	xcb_window_t	*wins;
+	u_int		 len;
+	u_int		 size;
+
+	/* How many leading windows the property already holds. */
+	u_int		 written;
+	bool		 rewrite;
 };
 
-static xcb_atom_t	 atom_from_string(const char *);
+/* Clients in the order they were mapped, and bottom to top. */
+static struct ewmh_window_list	 client_list = { .rewrite = true };
+static struct ewmh_window_list	 client_stacking = { .rewrite = true };
 
-static xcb_atom_t
-atom_from_string(const char *atom_name)
-{
-	xcb_intern_atom_cookie_t	 c;
-	xcb_intern_atom_reply_t		*r;
-	xcb_atom_t			 atom = XCB_ATOM_NONE;
+/* The last value written to, and the next value for, a property.  Setting
+ * a property only updates the shadow copy; ewmh_flush() writes those which
+ * have actually changed, once per trip round the event loop.
+ */
+struct ewmh_prop {
+	xcb_window_t		 win;
+	xcb_atom_t		 atom;
+	xcb_atom_t		 type;
+	uint8_t			 format;
 
-	c = xcb_intern_atom(dpy, 0, strlen(atom_name), atom_name);
-	r = xcb_intern_atom_reply(dpy, c, NULL);
-	if (r) {
-		atom = r->atom;
-		free(r);
-	}
-	return (atom);
-}
+	void			*value;
+	uint32_t		 len;
+	size_t			 size;
+
+	void			*written;
+	size_t			 written_size;
+	bool			 ever_written;
+
+	bool			 dirty;
+	RB_ENTRY(ewmh_prop)	 entry;
+	TAILQ_ENTRY(ewmh_prop)	 dirty_entry;
+};
+RB_HEAD(ewmh_props, ewmh_prop);
+TAILQ_HEAD(ewmh_dirty_props, ewmh_prop);
+
+static struct ewmh_props	 ewmh_props = RB_INITIALIZER(&ewmh_props);
+static struct ewmh_dirty_props	 ewmh_dirty_q =
+    TAILQ_HEAD_INITIALIZER(ewmh_dirty_q);
+
+static int	 ewmh_prop_cmp(struct ewmh_prop *, struct ewmh_prop *);
+RB_PROTOTYPE_STATIC(ewmh_props, ewmh_prop, entry, ewmh_prop_cmp);
+RB_GENERATE_STATIC(ewmh_props, ewmh_prop, entry, ewmh_prop_cmp);
+
+static void	 ewmh_prop_set(xcb_window_t, xcb_atom_t, xcb_atom_t,
+		     uint8_t, uint32_t, const void *);
+static void	 ewmh_prop_write(struct ewmh_prop *);
+static int	 ewmh_desktop_index(struct desktop *);
+static void	 ewmh_list_append(struct ewmh_window_list *, xcb_window_t);
+static void	 ewmh_list_remove(struct ewmh_window_list *, xcb_window_t);
+static void	 ewmh_list_flush(struct ewmh_window_list *, xcb_atom_t);
+
+/* Client-specific atoms, which aren't initialised by the EWMH API. */
+struct x_atoms	 cwmh_atoms[X_ATOM_MAX] = {
+#define X_ATOM(name) [X_ATOM_##name] = { #name, XCB_ATOM_NONE },
+	X_ATOMS
+#undef X_ATOM
+};
 
-xcb_atom_t
-x_atom_by_name(const char *name)
+/* Find which of our atoms an atom from the server is, or X_ATOM_MAX if it
+ * isn't one of them.
+ */
+enum x_atom
+x_atom_lookup(xcb_atom_t atom)
 {
-	u_int		 i;
-	xcb_atom_t	 atom = XCB_ATOM_NONE;
+	u_int	 i;
+
+	if (atom == XCB_ATOM_NONE)
+		return (X_ATOM_MAX);
 
-	for (i = 0; i < nitems(cwmh_atoms); i++) {
-		if (strcmp(name, cwmh_atoms[i].name) == 0) {
-			atom = cwmh_atoms[i].atom;
+	for (i = 0; i < X_ATOM_MAX; i++) {
+		if (cwmh_atoms[i].atom == atom)
 			break;
-		}
 	}
-	return (atom);
+	return (i);
 }
 
 void
 x_atoms_init(void)
 {
-	u_int		 i;
-	xcb_window_t	 child_win;
+	xcb_intern_atom_cookie_t	*ewmh_ck;
+	xcb_intern_atom_cookie_t	 ck[X_ATOM_MAX];
+	xcb_intern_atom_reply_t		*r;
+	u_int				 i;
+	xcb_window_t			 child_win;
 
 	ewmh = xmalloc(sizeof(xcb_ewmh_connection_t));
 
-	if (xcb_ewmh_init_atoms_replies(ewmh,
-	    xcb_ewmh_init_atoms(dpy, ewmh), NULL) == 0)
+	/* Send every intern request before waiting on any of them, so the
+	 * whole lot costs a single round trip.
+	 */
+	ewmh_ck = xcb_ewmh_init_atoms(dpy, ewmh);
+	for (i = 0; i < X_ATOM_MAX; i++) {
+		ck[i] = xcb_intern_atom(dpy, 0, strlen(cwmh_atoms[i].name),
+		    cwmh_atoms[i].name);
+	}
+
+	if (x_reply_seq(ewmh_ck[0].sequence, xcb_ewmh_init_atoms_replies,
+	    ewmh, ewmh_ck, NULL) == 0)
 		log_fatal("Unable to create EWMH atoms");
 
+	for (i = 0; i < X_ATOM_MAX; i++) {
+		r = x_reply(xcb_intern_atom_reply, dpy, ck[i], NULL);
+		if (r == NULL) {
+			log_msg("Couldn't intern atom %s", cwmh_atoms[i].name);
+			continue;
+		}
+		cwmh_atoms[i].atom = r->atom;
+		free(r);
+	}
+
 	xcb_ewmh_set_wm_name(ewmh, current_screen->root, 4, "lswm");
 
 	xcb_atom_t ewmh_atoms_supported[] = {
@@ -86,8 +149,12 @@ x_atoms_init(void)
 		ewmh->_NET_DESKTOP_NAMES,
 		ewmh->_NET_NUMBER_OF_DESKTOPS,
 		ewmh->_NET_CLIENT_LIST,
+		ewmh->_NET_CLIENT_LIST_STACKING,
 		ewmh->_NET_WM_STATE,
 		ewmh->_NET_WM_STATE_FULLSCREEN,
+		ewmh->_NET_WM_STATE_MAXIMIZED_VERT,
+		ewmh->_NET_WM_STATE_MAXIMIZED_HORZ,
+		ewmh->_NET_WM_STATE_HIDDEN,
 		ewmh->_NET_WM_STATE_DEMANDS_ATTENTION,
 		ewmh->_NET_WM_WINDOW_TYPE,
 		ewmh->_NET_WM_WINDOW_TYPE_UTILITY,
@@ -98,10 +165,6 @@ x_atoms_init(void)
 		ewmh->UTF8_STRING
 	};
 
-	/* Initialise all client atoms as well. */
-	for (i = 0; i < nitems(cwmh_atoms); i++)
-		cwmh_atoms[i].atom = atom_from_string(cwmh_atoms[i].name);
-
 	/* Create a window on the root window to select atoms on.  According
 	 * to the EWMH spec, such a window has to be present for as long as
 	 * the WM is running.
@@ -125,7 +188,8 @@ x_atoms_init(void)
 			    strlen(PROGNAME), PROGNAME);
 
 	xcb_change_property(dpy, XCB_PROP_MODE_REPLACE, current_screen->root,
-			    ewmh->_NET_SUPPORTED, XCB_ATOM_ATOM, 32, 18,
+			    ewmh->_NET_SUPPORTED, XCB_ATOM_ATOM, 32,
+			    nitems(ewmh_atoms_supported),
 			    ewmh_atoms_supported);
 
 	/* Tell XCB about the atoms we support. */
@@ -133,17 +197,344 @@ x_atoms_init(void)
 	    nitems(ewmh_atoms_supported), ewmh_atoms_supported);
 }
 
-#warning "ewmh_set_active_window() needs implementing"
+static int
+ewmh_prop_cmp(struct ewmh_prop *p1, struct ewmh_prop *p2)
+{
+	if (p1->win != p2->win)
+		return (p1->win < p2->win ? -1 : 1);
+	if (p1->atom != p2->atom)
+		return (p1->atom < p2->atom ? -1 : 1);
+	return (0);
+}
+
+/* Set a property, to be written when the loop next flushes if it differs
+ * from what was last written.
+ */
+static void
+ewmh_prop_set(xcb_window_t win, xcb_atom_t atom, xcb_atom_t type,
+    uint8_t format, uint32_t len, const void *value)
+{
+	struct ewmh_prop	 find, *p;
+	size_t			 size = len * (format / 8);
+
+	find.win = win;
+	find.atom = atom;
+	if ((p = RB_FIND(ewmh_props, &ewmh_props, &find)) == NULL) {
+		p = xcalloc(1, sizeof *p);
+		p->win = win;
+		p->atom = atom;
+		RB_INSERT(ewmh_props, &ewmh_props, p);
+	}
+
+	if (p->type == type && p->format == format && p->size == size &&
+	    (size == 0 || memcmp(p->value, value, size) == 0))
+		return;
+
+	p->type = type;
+	p->format = format;
+	p->len = len;
+	p->size = size;
+	free(p->value);
+	p->value = NULL;
+	if (size != 0) {
+		p->value = xmalloc(size);
+		memcpy(p->value, value, size);
+	}
+
+	if (!p->dirty) {
+		p->dirty = true;
+		TAILQ_INSERT_TAIL(&ewmh_dirty_q, p, dirty_entry);
+	}
+}
+
+static void
+ewmh_prop_write(struct ewmh_prop *p)
+{
+	/* Changed back to what's already there before being flushed. */
+	if (p->ever_written && p->written_size == p->size &&
+	    (p->size == 0 || memcmp(p->written, p->value, p->size) == 0))
+		return;
+
+	xcb_change_property(dpy, XCB_PROP_MODE_REPLACE, p->win, p->atom,
+	    p->type, p->format, p->len, p->value);
+
+	free(p->written);
+	p->written = NULL;
+	if (p->size != 0) {
+		p->written = xmalloc(p->size);
+		memcpy(p->written, p->value, p->size);
+	}
+	p->written_size = p->size;
+	p->ever_written = true;
+}
+
+/* Drop everything remembered about a window which has gone away. */
 void
-ewmh_set_active_window(void)
+ewmh_prop_forget(xcb_window_t win)
 {
-	return;
+	struct ewmh_prop	 find, *p, *p1;
+
+	find.win = win;
+	find.atom = 0;
+	p = RB_NFIND(ewmh_props, &ewmh_props, &find);
+	for (; p != NULL && p->win == win; p = p1) {
+		p1 = RB_NEXT(ewmh_props, &ewmh_props, p);
+
+		RB_REMOVE(ewmh_props, &ewmh_props, p);
+		if (p->dirty)
+			TAILQ_REMOVE(&ewmh_dirty_q, p, dirty_entry);
+		free(p->value);
+		free(p->written);
+		free(p);
+	}
+}
+
+/* Desktops in use are numbered across all monitors in turn. */
+static int
+ewmh_desktop_index(struct desktop *dt)
+{
+	struct monitor	*m;
+	u_int		 i = 0, j;
+
+	if (dt == NULL)
+		return (-1);
+
+	TAILQ_FOREACH(m, &monitor_q, entry) {
+		if (m == dt->monitor)
+			break;
+		i += m->ndesktops;
+	}
+	if (m == NULL)
+		return (-1);
+
+	for (j = 0; j < dt->idx; j++) {
+		if (m->desktops[j] != NULL)
+			i++;
+	}
+	return (i);
+}
+
+/* The set of desktops has changed, and with it how they're numbered. */
+void
+ewmh_update_desktops(void)
+{
+	struct monitor	*m;
+	struct desktop	*d;
+	struct client	*c;
+
+	ewmh_set_no_of_desktops();
+	ewmh_set_desktop_names();
+	ewmh_set_current_desktop();
+
+	TAILQ_FOREACH(m, &monitor_q, entry) {
+		TAILQ_FOREACH(d, &m->desktops_q, entry) {
+			TAILQ_FOREACH(c, &d->clients_q, entry)
+				ewmh_set_wm_desktop(c);
+		}
+	}
 }
 
+void
+ewmh_set_active_window(void)
+{
+	struct client	*c;
+	xcb_window_t	 win = XCB_NONE;
+
+	if ((c = client_get_current()) != NULL)
+		win = c->win;
+
+	ewmh_prop_set(current_screen->root, ewmh->_NET_ACTIVE_WINDOW,
+	    XCB_ATOM_WINDOW, 32, 1, &win);
+}
 
-#warning "ewmh_set_no_of_desktops() needs implementing"
 void
 ewmh_set_no_of_desktops(void)
 {
-	return;
+	uint32_t	 n;
+
+	n = desktop_count_all_desktops();
+	ewmh_prop_set(current_screen->root, ewmh->_NET_NUMBER_OF_DESKTOPS,
+	    XCB_ATOM_CARDINAL, 32, 1, &n);
+}
+
+void
+ewmh_set_current_desktop(void)
+{
+	struct desktop	*d;
+	int		 idx;
+	uint32_t	 n;
+
+	d = desktop_get_current();
+
+	if ((idx = ewmh_desktop_index(d)) == -1)
+		idx = 0;
+	n = idx;
+
+	ewmh_prop_set(current_screen->root, ewmh->_NET_CURRENT_DESKTOP,
+	    XCB_ATOM_CARDINAL, 32, 1, &n);
+}
+
+void
+ewmh_set_desktop_names(void)
+{
+	struct monitor	*m;
+	struct desktop	*d;
+	char		*names = NULL;
+	size_t		 len = 0, n;
+
+	/* Each name is terminated by a NUL, including the last. */
+	TAILQ_FOREACH(m, &monitor_q, entry) {
+		TAILQ_FOREACH(d, &m->desktops_q, entry) {
+			n = strlen(d->name) + 1;
+			names = xrealloc(names, len + n, 1);
+			memcpy(names + len, d->name, n);
+			len += n;
+		}
+	}
+
+	ewmh_prop_set(current_screen->root, ewmh->_NET_DESKTOP_NAMES,
+	    ewmh->UTF8_STRING, 8, len, names);
+	free(names);
+}
+
+/* Set WM_STATE and _NET_WM_STATE from the client's flags and geometry. */
+void
+ewmh_set_wm_state(struct client *c)
+{
+	xcb_atom_t	 states[4];
+	uint32_t	 wm_state[2];
+	u_int		 n = 0;
+
+	wm_state[0] = (c->flags & CLIENT_HIDDEN) ?
+	    XCB_ICCCM_WM_STATE_ICONIC : XCB_ICCCM_WM_STATE_NORMAL;
+	wm_state[1] = XCB_NONE;
+	ewmh_prop_set(c->win, x_atom(WM_STATE), x_atom(WM_STATE), 32, 2,
+	    wm_state);
+
+	if (c->flags & CLIENT_HIDDEN)
+		states[n++] = ewmh->_NET_WM_STATE_HIDDEN;
+	switch (c->geom.state) {
+	case FULLSCREEN:
+		states[n++] = ewmh->_NET_WM_STATE_FULLSCREEN;
+		break;
+	case MAXIMISED:
+		states[n++] = ewmh->_NET_WM_STATE_MAXIMIZED_VERT;
+		states[n++] = ewmh->_NET_WM_STATE_MAXIMIZED_HORZ;
+		break;
+	case MAXIMISED_VERT:
+		states[n++] = ewmh->_NET_WM_STATE_MAXIMIZED_VERT;
+		break;
+	case MAXIMISED_HORIZ:
+		states[n++] = ewmh->_NET_WM_STATE_MAXIMIZED_HORZ;
+		break;
+	case NORMAL:
+		break;
+	}
+	ewmh_prop_set(c->win, ewmh->_NET_WM_STATE, XCB_ATOM_ATOM, 32, n,
+	    states);
+}
+
+void
+ewmh_set_wm_desktop(struct client *c)
+{
+	int		 idx;
+	uint32_t	 n;
+
+	if ((idx = ewmh_desktop_index(c->desktop)) == -1)
+		return;
+	n = idx;
+
+	ewmh_prop_set(c->win, ewmh->_NET_WM_DESKTOP, XCB_ATOM_CARDINAL, 32,
+	    1, &n);
+}
+
+static void
+ewmh_list_append(struct ewmh_window_list *l, xcb_window_t win)
+{
+	if (l->len == l->size) {
+		l->size = l->size == 0 ? 64 : l->size * 2;
+		l->wins = xrealloc(l->wins, l->size, sizeof *l->wins);
+	}
+	l->wins[l->len++] = win;
+}
+
+static void
+ewmh_list_remove(struct ewmh_window_list *l, xcb_window_t win)
+{
+	u_int	 i;
+
+	for (i = 0; i < l->len; i++) {
+		if (l->wins[i] == win)
+			break;
+	}
+	if (i == l->len)
+		return;
+
+	memmove(&l->wins[i], &l->wins[i + 1],
+	    (l->len - i - 1) * sizeof *l->wins);
+	l->len--;
+
+	/* Only a window not yet written can go without a rewrite. */
+	if (i < l->written)
+		l->rewrite = true;
+}
+
+/* Bring the property up to date, appending if that's all it needs. */
+static void
+ewmh_list_flush(struct ewmh_window_list *l, xcb_atom_t atom)
+{
+	if (l->rewrite) {
+		xcb_change_property(dpy, XCB_PROP_MODE_REPLACE,
+		    current_screen->root, atom, XCB_ATOM_WINDOW, 32,
+		    l->len, l->wins);
+	} else if (l->written < l->len) {
+		xcb_change_property(dpy, XCB_PROP_MODE_APPEND,
+		    current_screen->root, atom, XCB_ATOM_WINDOW, 32,
+		    l->len - l->written, &l->wins[l->written]);
+	}
+	l->written = l->len;
+	l->rewrite = false;
+}
+
+void
+ewmh_client_list_add(xcb_window_t win)
+{
+	ewmh_list_append(&client_list, win);
+	ewmh_list_append(&client_stacking, win);
+}
+
+void
+ewmh_client_list_remove(xcb_window_t win)
+{
+	ewmh_list_remove(&client_list, win);
+	ewmh_list_remove(&client_stacking, win);
+}
+
+/* The window has been raised to the top of the stack. */
+void
+ewmh_client_list_raise(xcb_window_t win)
+{
+	if (client_stacking.len > 0 &&
+	    client_stacking.wins[client_stacking.len - 1] == win)
+		return;
+
+	ewmh_list_remove(&client_stacking, win);
+	ewmh_list_append(&client_stacking, win);
+	client_stacking.rewrite = true;
+}
+
+/* Write out whatever has changed since the last time round the loop. */
+void
+ewmh_flush(void)
+{
+	struct ewmh_prop	*p;
+
+	while ((p = TAILQ_FIRST(&ewmh_dirty_q)) != NULL) {
+		TAILQ_REMOVE(&ewmh_dirty_q, p, dirty_entry);
+		p->dirty = false;
+		ewmh_prop_write(p);
+	}
+
+	ewmh_list_flush(&client_list, ewmh->_NET_CLIENT_LIST);
+	ewmh_list_flush(&client_stacking, ewmh->_NET_CLIENT_LIST_STACKING);
 }
@@ -24,72 +24,186 @@
 #include <xcb/xcb_keysyms.h>
 #include "lswm.h"
 
+/* A keysym and one of the keycodes which produce it. */
+struct keymap_entry {
+	xcb_keysym_t	 sym;
+	xcb_keycode_t	 code;
+};
+
+/* Our copy of the keyboard mapping.  Asking the server for it is a
+ * round-trip, so it's fetched once and then only again on MappingNotify.
+ */
+static struct {
+	/* The unshifted keysym for each keycode. */
+	xcb_keysym_t		 syms[256];
+
+	/* Every (keysym, keycode) pair, sorted by keysym. */
+	struct keymap_entry	*codes;
+	u_int			 ncodes;
+
+	u_int			 numlock;
+} keymap;
+
+/* Bindings hashed on what triggers them, so that a key or button press
+ * can be matched without walking every binding.  Lock and NumLock are
+ * never part of a binding's modifiers; they are stripped from events
+ * before looking them up.
+ */
+#define BINDING_INDEX_MIN	64
+static struct binding_index_bucket	*binding_index;
+static u_int				 binding_index_size;
+static u_int				 binding_index_count;
+
 static void		 add_binding(u_int, union pressed, u_int, const char *);
+static u_int		 binding_hash(u_int, u_int, u_int, u_int);
+static u_int		 binding_pressed(u_int, union pressed);
+static void		 binding_index_resize(u_int);
 static void		 print_key_bindings(void);
-static u_int		 find_numlock(void);
-static xcb_keycode_t	*get_keycodes(xcb_keysym_t);
+static int		 keymap_cmp(const void *, const void *);
+static u_int		 keymap_find_numlock(xcb_get_modifier_mapping_reply_t *);
+static u_int		 get_keycodes(xcb_keysym_t, xcb_keycode_t *, u_int);
 
-static u_int
-find_numlock(void)
+static int
+keymap_cmp(const void *a, const void *b)
+{
+	const struct keymap_entry	*ka = a, *kb = b;
+
+	if (ka->sym != kb->sym)
+		return (ka->sym < kb->sym ? -1 : 1);
+	return (ka->code - kb->code);
+}
+
+/* Fetch the keyboard and modifier mappings and rebuild our tables. */
+void
+keymap_update(void)
 {
+	xcb_get_keyboard_mapping_cookie_t	 km_ck;
+	xcb_get_modifier_mapping_cookie_t	 mm_ck;
+	xcb_get_keyboard_mapping_reply_t	*km_reply;
 	xcb_get_modifier_mapping_reply_t	*mm_reply;
-	xcb_keycode_t				*modmap, *numlock, kc;
-	u_int					 i, j, k, numlockmask;
+	const xcb_setup_t			*setup;
+	xcb_keysym_t				*syms, sym;
+	u_int					 i, j, n, per, count;
+
+	setup = xcb_get_setup(dpy);
+	count = setup->max_keycode - setup->min_keycode + 1;
+
+	rtt_op_begin("keymap");
+	km_ck = xcb_get_keyboard_mapping(dpy, setup->min_keycode, count);
+	mm_ck = xcb_get_modifier_mapping_unchecked(dpy);
 
-	if ((mm_reply = xcb_get_modifier_mapping_reply(dpy,
-	    xcb_get_modifier_mapping_unchecked(dpy), NULL)) == NULL) {
+	if ((km_reply = x_reply(xcb_get_keyboard_mapping_reply, dpy, km_ck,
+	    NULL)) == NULL)
+		log_fatal("Couldn't acquire keyboard map");
+	if ((mm_reply = x_reply(xcb_get_modifier_mapping_reply, dpy, mm_ck,
+	    NULL)) == NULL)
 		log_fatal("Couldn't acquire modifier map");
-		exit (1);
+
+	syms = xcb_get_keyboard_mapping_keysyms(km_reply);
+	per = km_reply->keysyms_per_keycode;
+
+	free(keymap.codes);
+	keymap.codes = xcalloc(count * MAX(per, 1), sizeof *keymap.codes);
+	keymap.ncodes = 0;
+	memset(keymap.syms, 0, sizeof keymap.syms);
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < per; j++) {
+			sym = syms[i * per + j];
+			if (sym == XCB_NO_SYMBOL)
+				continue;
+			if (j == 0)
+				keymap.syms[setup->min_keycode + i] = sym;
+
+			n = keymap.ncodes++;
+			keymap.codes[n].sym = sym;
+			keymap.codes[n].code = setup->min_keycode + i;
+		}
 	}
+	qsort(keymap.codes, keymap.ncodes, sizeof *keymap.codes, keymap_cmp);
+
+	keymap.numlock = keymap_find_numlock(mm_reply);
+
+	log_msg("Keymap: %u keysyms over %u keycodes, numlock is 0x%x",
+	    keymap.ncodes, count, keymap.numlock);
+
+	free(mm_reply);
+	free(km_reply);
+	rtt_op_end();
+}
+
+/* Look up the unshifted keysym for a keycode. */
+xcb_keysym_t
+keymap_keysym(xcb_keycode_t code)
+{
+	return (keymap.syms[code]);
+}
+
+static u_int
+keymap_find_numlock(xcb_get_modifier_mapping_reply_t *mm_reply)
+{
+	xcb_keycode_t	*modmap, numlock[8], kc;
+	u_int		 i, j, k, n, numlockmask = 0;
 
 	if ((modmap = xcb_get_modifier_mapping_keycodes(mm_reply)) == NULL) {
 		log_fatal("Couldn't acquire modmap");
 		exit (1);
 	}
 
-	numlock = get_keycodes(XK_Num_Lock);
+	n = get_keycodes(XK_Num_Lock, numlock, nitems(numlock));
 
 	for (i = 0; i < 8; i++) {
 		for (j = 0; j < mm_reply->keycodes_per_modifier; j++) {
 			kc = modmap[i * mm_reply->keycodes_per_modifier + j];
 			if (kc == XCB_NO_SYMBOL)
 				continue;
-			if (numlock != NULL) {
-				for (k = 0; numlock[k] != XCB_NO_SYMBOL; k++) {
-					if (numlock[k] == kc) {
-						numlockmask = 1 << i;
-						break;
-					}
+			for (k = 0; k < n; k++) {
+				if (numlock[k] == kc) {
+					numlockmask = 1 << i;
+					break;
 				}
 			}
 		}
 	}
-	free (numlock);
-	free (mm_reply);
 
 	return (numlockmask);
 }
 
-static
-xcb_keycode_t* get_keycodes(xcb_keysym_t keysym)
+/* Fill kc with up to len keycodes producing keysym, returning how many
+ * there are.
+ */
+static u_int
+get_keycodes(xcb_keysym_t keysym, xcb_keycode_t *kc, u_int len)
 {
-	xcb_key_symbols_t	*keysyms;
-	xcb_keycode_t		*keycode;
+	u_int	 lo, hi, mid, n = 0;
 
-	if ((keysyms = xcb_key_symbols_alloc(dpy)) == NULL)
-		return (NULL);
+	/* Find the first entry for this keysym. */
+	lo = 0;
+	hi = keymap.ncodes;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (keymap.codes[mid].sym < keysym)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-	keycode = xcb_key_symbols_get_keycode(keysyms, keysym);
-	xcb_key_symbols_free(keysyms);
+	for (; lo < keymap.ncodes && keymap.codes[lo].sym == keysym; lo++) {
+		if (n == len)
+			break;
+		/* The same keycode can produce a keysym in several columns. */
+		if (n > 0 && kc[n - 1] == keymap.codes[lo].code)
+			continue;
+		kc[n++] = keymap.codes[lo].code;
+	}
 
-	return (keycode);
+	return (n);
 }
 
 void
 setup_bindings(void)
 {
-	u_int		 i, j, l, mouse, mbutton, modifiers;
-	u_int		 modifiers_array[4], numlock;
+	u_int		 i, j, mouse, mbutton, modifiers;
 	xcb_keysym_t	 keysym;
 
 	union pressed	 pressed;
@@ -105,13 +219,9 @@ setup_bindings(void)
 		{ "4", "1", "move", TYPE_MOUSE },
 	};
 
-	numlock = find_numlock();
-	modifiers_array[0] = 0;
-	modifiers_array[1] = XCB_MOD_MASK_LOCK;
-	modifiers_array[2] = numlock;
-	modifiers_array[3] = numlock | XCB_MOD_MASK_LOCK;
-
 	for (i = 0; i < nitems(all_bindings); i++) {
+		modifiers = 0;
+		mbutton = 0;
 		switch (all_bindings[i].type) {
 		case TYPE_KEY: {
 			keysym = xkb_keysym_from_name(all_bindings[i].key_name,
@@ -150,6 +260,11 @@ setup_bindings(void)
 					break;
 				}
 			}
+			if (mbutton == 0) {
+				log_msg("Unable to bind mouse button: %s",
+					all_bindings[i].key_name);
+				continue;
+			}
 			pressed.button = mbutton;
 		}
 		}
@@ -172,11 +287,8 @@ setup_bindings(void)
 				break;
 			}
 		}
-		for (l = 0; l < nitems(modifiers_array); l++) {
-			add_binding(modifiers | modifiers_array[l],
-					pressed, all_bindings[i].type,
-					all_bindings[i].command_string);
-		}
+		add_binding(modifiers, pressed, all_bindings[i].type,
+		    all_bindings[i].command_string);
 	}
 	grab_all_bindings(current_screen->root);
 	print_key_bindings();
@@ -195,60 +307,180 @@ void
 grab_all_bindings(xcb_window_t win)
 {
 	struct binding	*kb;
-	xcb_keycode_t	*kc;
-	u_int		 i;
+	xcb_keycode_t	 kc[8];
+	u_int		 i, l, n, locks[4];
 
 	uint32_t values[] = {
 		XCB_EVENT_MASK_EXPOSURE|XCB_EVENT_MASK_BUTTON_PRESS|
-		XCB_EVENT_MASK_BUTTON_RELEASE|XCB_EVENT_MASK_POINTER_MOTION|
+		XCB_EVENT_MASK_BUTTON_RELEASE|
 		XCB_EVENT_MASK_ENTER_WINDOW|XCB_EVENT_MASK_LEAVE_WINDOW|
                 XCB_EVENT_MASK_KEY_PRESS|XCB_EVENT_MASK_KEY_RELEASE
 	};
-	xcb_change_window_attributes(dpy, win, XCB_CW_EVENT_MASK, values);
+	/* The root window's events were selected when we started; replacing
+	 * them would lose SubstructureRedirect.  Motion isn't selected here:
+	 * it's only wanted during a drag, which grabs the pointer for it.
+	 */
+	if (win != current_screen->root)
+		xcb_change_window_attributes(dpy, win, XCB_CW_EVENT_MASK, values);
 
 	xcb_ungrab_key(dpy, XCB_GRAB_ANY, win, XCB_MOD_MASK_ANY);
+	xcb_ungrab_button(dpy, XCB_BUTTON_INDEX_ANY, win, XCB_MOD_MASK_ANY);
+
+	/* Bindings are stored without Lock or NumLock, but the server
+	 * matches grabs on the exact modifiers, so grab each combination.
+	 */
+	locks[0] = 0;
+	locks[1] = XCB_MOD_MASK_LOCK;
+	locks[2] = keymap.numlock;
+	locks[3] = keymap.numlock | XCB_MOD_MASK_LOCK;
 
 	TAILQ_FOREACH(kb, &global_bindings, entry) {
 		switch (kb->type) {
 		case TYPE_KEY: {
-			kc = get_keycodes(kb->p.key);
+			n = get_keycodes(kb->p.key, kc, nitems(kc));
 
-			for (i = 0; kc[i] != XCB_NO_SYMBOL; i++) {
+			for (i = 0; i < n; i++) {
 				log_msg("Grabbing key with keysym: '%d' 0x%x",
 					kc[i], win);
-				xcb_grab_key(dpy, 0, win, kb->modifier,
-				    kc[i], XCB_GRAB_MODE_SYNC,
-				    XCB_GRAB_MODE_ASYNC);
+				for (l = 0; l < nitems(locks); l++) {
+					xcb_grab_key(dpy, 0, win,
+					    kb->modifier | locks[l], kc[i],
+					    XCB_GRAB_MODE_ASYNC,
+					    XCB_GRAB_MODE_ASYNC);
+				}
 			}
-			free(kc);
 		}
 			break;
 		case TYPE_MOUSE:
 			log_msg("Grabbing mouse button (win: 0x%x)...", win);
-			xcb_grab_button(dpy, 0, win,
-					XCB_EVENT_MASK_BUTTON_PRESS,
-					XCB_GRAB_MODE_SYNC,
-					XCB_GRAB_MODE_ASYNC,
-					XCB_NONE,
-					XCB_NONE,
-					kb->p.button, kb->modifier);
+			for (l = 0; l < nitems(locks); l++) {
+				xcb_grab_button(dpy, 0, win,
+						XCB_EVENT_MASK_BUTTON_PRESS,
+						XCB_GRAB_MODE_ASYNC,
+						XCB_GRAB_MODE_ASYNC,
+						XCB_NONE,
+						XCB_NONE,
+						kb->p.button,
+						kb->modifier | locks[l]);
+			}
 			break;
 		}
 	}
 }
 
+/* The keyboard mapping has changed, so the keycodes grabbed for every
+ * binding may be wrong; grab them again everywhere.
+ */
+void
+regrab_all_bindings(void)
+{
+	struct monitor	*m;
+	struct desktop	*d;
+	struct client	*c;
+
+	grab_all_bindings(current_screen->root);
+
+	TAILQ_FOREACH(m, &monitor_q, entry) {
+		TAILQ_FOREACH(d, &m->desktops_q, entry) {
+			TAILQ_FOREACH(c, &d->clients_q, entry)
+				grab_all_bindings(c->win);
+		}
+	}
+}
+
+/* Strip the modifiers which bindings ignore from an event's state. */
+u_int
+keymap_clean_mask(u_int state)
+{
+	state &= XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_CONTROL |
+	    XCB_MOD_MASK_1 | XCB_MOD_MASK_2 | XCB_MOD_MASK_3 |
+	    XCB_MOD_MASK_4 | XCB_MOD_MASK_5;
+
+	return (state & ~(XCB_MOD_MASK_LOCK | keymap.numlock));
+}
+
+static u_int
+binding_pressed(u_int type, union pressed p)
+{
+	return (type == TYPE_KEY ? p.key : p.button);
+}
+
+static u_int
+binding_hash(u_int type, u_int pressed, u_int modifier, u_int size)
+{
+	u_int	 h;
+
+	h = (pressed * 2654435761U) ^ (modifier << 16) ^ type;
+	return ((h ^ (h >> 15)) & (size - 1));
+}
+
+static void
+binding_index_resize(u_int size)
+{
+	struct binding_index_bucket	*old = binding_index;
+	struct binding			*kb;
+	u_int				 old_size = binding_index_size, i, h;
+
+	binding_index = xcalloc(size, sizeof *binding_index);
+	binding_index_size = size;
+	for (i = 0; i < size; i++)
+		LIST_INIT(&binding_index[i]);
+
+	for (i = 0; i < old_size; i++) {
+		while ((kb = LIST_FIRST(&old[i])) != NULL) {
+			LIST_REMOVE(kb, index_entry);
+			h = binding_hash(kb->type,
+			    binding_pressed(kb->type, kb->p), kb->modifier, size);
+			LIST_INSERT_HEAD(&binding_index[h], kb, index_entry);
+		}
+	}
+	free(old);
+}
+
+/* Find the binding for a key or button.  The modifier must already have
+ * been cleaned with keymap_clean_mask().
+ */
+struct binding *
+binding_find(u_int type, u_int pressed, u_int modifier)
+{
+	struct binding	*kb;
+	u_int		 h;
+
+	if (binding_index == NULL)
+		return (NULL);
+
+	h = binding_hash(type, pressed, modifier, binding_index_size);
+	LIST_FOREACH(kb, &binding_index[h], index_entry) {
+		if (kb->type == type && kb->modifier == modifier &&
+		    binding_pressed(kb->type, kb->p) == pressed)
+			return (kb);
+	}
+	return (NULL);
+}
+
 static void
 add_binding(u_int modifiers, union pressed p, u_int type, const char *cmd)
 {
 	struct cmd_list		*cmds;
 	struct binding		*kb;
 	char			*cause;
+	u_int			 h;
 
 	if ((cmd_string_parse(cmd, &cmds, NULL, -1, &cause)) == -1) {
 		log_msg("Couldn't get valid command: %s", cause);
 		return;
 	}
-	kb = xmalloc(sizeof *kb);
+
+	/* Rebinding replaces the existing command. */
+	modifiers &= ~(XCB_MOD_MASK_LOCK | keymap.numlock);
+	if ((kb = binding_find(type, binding_pressed(type, p),
+	    modifiers)) != NULL) {
+		cmd_list_free(kb->cmd_list);
+		kb->cmd_list = cmds;
+		return;
+	}
+
+	kb = pool_get(POOL_BINDING);
 	kb->modifier = modifiers;
 	kb->p = p;
 	kb->type = type;
@@ -258,4 +490,14 @@ add_binding(u_int modifiers, union pressed p, u_int type, const char *cmd)
 		TAILQ_INSERT_HEAD(&global_bindings, kb, entry);
 	else
 		TAILQ_INSERT_TAIL(&global_bindings, kb, entry);
+
+	if (binding_index == NULL)
+		binding_index_resize(BINDING_INDEX_MIN);
+	else if (binding_index_count >= binding_index_size)
+		binding_index_resize(binding_index_size * 2);
+
+	h = binding_hash(type, binding_pressed(type, p), modifiers,
+	    binding_index_size);
+	LIST_INSERT_HEAD(&binding_index[h], kb, index_entry);
+	binding_index_count++;
 }
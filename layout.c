@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2013 Thomas Adam <thomas@xteddy.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Routines for remembering what was on monitors which have gone away.
+ *
+ * When a monitor is removed, which of its desktops was shown and where
+ * its clients were are saved under the output's name and a hash of its
+ * EDID.  If the same monitor comes back, everything is put back in one
+ * go.  Layouts can also be kept in a file, so that restarting picks up
+ * where things were.  Clients are only known by window ID, which means
+ * nothing to a different X server, so the file is tied to the server it
+ * was written under.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "lswm.h"
+
+struct layout_client {
+	xcb_window_t		 win;
+	u_int			 desktop;
+
+	/* Relative to the monitor. */
+	struct rectangle	 coords;
+	int			 state;
+};
+
+struct layout {
+	char			*name;
+	uint32_t		 edid;
+	u_int			 active;
+
+	struct layout_client	*clients;
+	u_int			 nclients;
+
+	TAILQ_ENTRY(layout)	 entry;
+};
+TAILQ_HEAD(layouts, layout);
+
+static struct layouts	 layouts_q = TAILQ_HEAD_INITIALIZER(layouts_q);
+static char		*layout_path;
+static char		*layout_session;
+
+static struct layout	*layout_find(const char *, uint32_t);
+static struct layout	*layout_new(const char *, uint32_t);
+static void		 layout_free(struct layout *);
+static void		 layout_add_client(struct layout *, xcb_window_t,
+			     u_int, struct rectangle *, int);
+static void		 layout_fill(struct layout *, struct monitor *);
+static void		 layout_print(FILE *, struct layout *);
+static void		 layout_get_session(void);
+
+/* A different EDID means a different monitor, unless one isn't known. */
+static struct layout *
+layout_find(const char *name, uint32_t edid)
+{
+	struct layout	*l;
+
+	TAILQ_FOREACH(l, &layouts_q, entry) {
+		if (strcmp(l->name, name) != 0)
+			continue;
+		if (l->edid == 0 || edid == 0 || l->edid == edid)
+			return (l);
+	}
+	return (NULL);
+}
+
+static struct layout *
+layout_new(const char *name, uint32_t edid)
+{
+	struct layout	*l;
+
+	if ((l = layout_find(name, edid)) != NULL) {
+		TAILQ_REMOVE(&layouts_q, l, entry);
+		layout_free(l);
+	}
+
+	l = xcalloc(1, sizeof *l);
+	l->name = xstrdup(name);
+	l->edid = edid;
+	TAILQ_INSERT_TAIL(&layouts_q, l, entry);
+
+	return (l);
+}
+
+static void
+layout_free(struct layout *l)
+{
+	free(l->name);
+	free(l->clients);
+	free(l);
+}
+
+static void
+layout_add_client(struct layout *l, xcb_window_t win, u_int desktop,
+    struct rectangle *coords, int state)
+{
+	struct layout_client	*lc;
+
+	l->clients = xrealloc(l->clients, l->nclients + 1,
+	    sizeof *l->clients);
+	lc = &l->clients[l->nclients++];
+
+	lc->win = win;
+	lc->desktop = desktop;
+	lc->coords = *coords;
+	lc->state = state;
+}
+
+static void
+layout_fill(struct layout *l, struct monitor *m)
+{
+	struct desktop		*d;
+	struct client		*c;
+	struct rectangle	 r;
+
+	if (m->active_desktop != NULL)
+		l->active = m->active_desktop->idx;
+
+	TAILQ_FOREACH(d, &m->desktops_q, entry) {
+		TAILQ_FOREACH(c, &d->clients_q, entry) {
+			r = c->geom.coords;
+			r.x -= m->size.x;
+			r.y -= m->size.y;
+			layout_add_client(l, c->win, d->idx, &r, c->geom.state);
+		}
+	}
+}
+
+/* Remember what's on a monitor which is about to go away. */
+void
+layout_save(struct monitor *m)
+{
+	struct layout	*l;
+
+	l = layout_new(m->name, m->edid);
+	layout_fill(l, m);
+
+	log_msg("Saved layout of %s: %u clients", m->name, l->nclients);
+	layout_write();
+}
+
+/* Put back whatever was on a monitor last time it was seen.  Clients
+ * which have gone since are skipped.
+ */
+void
+layout_restore(struct monitor *m)
+{
+	struct layout		*l;
+	struct layout_client	*lc;
+	struct client		*c;
+	struct desktop		*d;
+	u_int			 i, n = 0;
+
+	if ((l = layout_find(m->name, m->edid)) == NULL)
+		return;
+
+	/* Show the right desktop first, so clients going on to it are
+	 * shown and the rest hidden.  This isn't the user switching, so
+	 * the current desktop stays as it is.
+	 */
+	if ((d = desktop_get(m, l->active)) != NULL)
+		desktop_show(m, d);
+
+	for (i = 0; i < l->nclients; i++) {
+		lc = &l->clients[i];
+		if ((c = client_find_by_window(lc->win)) == NULL)
+			continue;
+		if ((d = desktop_get(m, lc->desktop)) == NULL)
+			continue;
+
+		/* Fit in case the monitor's not quite as it was, before
+		 * moving so the client is shown where it belongs.
+		 */
+		c->geom.coords = lc->coords;
+		c->geom.coords.x += m->size.x;
+		c->geom.coords.y += m->size.y;
+		c->geom.state = lc->state;
+		client_fit_to_monitor(c, &m->size, m);
+
+		client_move_to_desktop(c, d);
+		n++;
+	}
+	log_msg("Restored layout of %s: %u of %u clients", m->name, n,
+	    l->nclients);
+
+	TAILQ_REMOVE(&layouts_q, l, entry);
+	layout_free(l);
+}
+
+/* Find which X server this is from a property on the root, which lasts
+ * as long as the server does.  If it isn't there, this is the first time
+ * round, so make one up.
+ */
+static void
+layout_get_session(void)
+{
+	xcb_get_property_reply_t	*r;
+	int				 len;
+
+	r = x_reply(xcb_get_property_reply, dpy, xcb_get_property(dpy, 0,
+	    current_screen->root, x_atom(_LSWM_SESSION), XCB_ATOM_STRING, 0,
+	    64), NULL);
+	if (r != NULL && (len = xcb_get_property_value_length(r)) > 0) {
+		xasprintf(&layout_session, "%.*s", len,
+		    (char *)xcb_get_property_value(r));
+	} else {
+		xasprintf(&layout_session, "%llx-%lx-%llx",
+		    (unsigned long long)time(NULL), (long)getpid(),
+		    (unsigned long long)event_now());
+		xcb_change_property(dpy, XCB_PROP_MODE_REPLACE,
+		    current_screen->root, x_atom(_LSWM_SESSION),
+		    XCB_ATOM_STRING, 8, strlen(layout_session),
+		    layout_session);
+	}
+	free(r);
+}
+
+/* Keep layouts in a file, read now and written whenever one is saved.  A
+ * file from another X server is ignored, and replaced when next written.
+ */
+void
+layout_load(const char *path)
+{
+	struct layout		*l = NULL;
+	struct rectangle	 r;
+	FILE			*f;
+	char			 line[BUFSIZ], name[256];
+	u_int			 win, desktop, active;
+	uint32_t		 edid;
+	int			 state;
+
+	free(layout_path);
+	layout_path = xstrdup(path);
+	if (layout_session == NULL)
+		layout_get_session();
+
+	if ((f = fopen(path, "r")) == NULL) {
+		if (errno != ENOENT)
+			log_msg("Couldn't read %s: %s", path, strerror(errno));
+		return;
+	}
+
+	if (fgets(line, sizeof line, f) == NULL ||
+	    sscanf(line, "session %255s", name) != 1 ||
+	    strcmp(name, layout_session) != 0) {
+		log_msg("%s: not from this X server, ignoring", path);
+		fclose(f);
+		return;
+	}
+
+	while (fgets(line, sizeof line, f) != NULL) {
+		if (sscanf(line, "monitor %255s %x %u", name, &edid,
+		    &active) == 3) {
+			l = layout_new(name, edid);
+			l->active = active;
+		} else if (l != NULL && sscanf(line,
+		    "client %x %u %d %d %d %d %d", &win, &desktop, &r.x, &r.y,
+		    &r.w, &r.h, &state) == 7)
+			layout_add_client(l, win, desktop, &r, state);
+		else
+			log_msg("%s: ignoring '%.*s'", path,
+			    (int)strcspn(line, "\n"), line);
+	}
+	fclose(f);
+}
+
+static void
+layout_print(FILE *f, struct layout *l)
+{
+	struct layout_client	*lc;
+	u_int			 i;
+
+	fprintf(f, "monitor %s %x %u\n", l->name, l->edid, l->active);
+	for (i = 0; i < l->nclients; i++) {
+		lc = &l->clients[i];
+		fprintf(f, "client %x %u %d %d %d %d %d\n", lc->win,
+		    lc->desktop, lc->coords.x, lc->coords.y, lc->coords.w,
+		    lc->coords.h, lc->state);
+	}
+}
+
+/* Write out the layouts of the monitors there now, and of those saved.
+ * They go to a temporary file first, which replaces the old one only once
+ * it's complete.
+ */
+void
+layout_write(void)
+{
+	struct layout	*l, cur;
+	struct monitor	*m;
+	FILE		*f;
+	char		*tmp;
+
+	if (layout_path == NULL)
+		return;
+	xasprintf(&tmp, "%s.tmp", layout_path);
+	if ((f = fopen(tmp, "w")) == NULL) {
+		log_msg("Couldn't write %s: %s", tmp, strerror(errno));
+		free(tmp);
+		return;
+	}
+
+	fprintf(f, "session %s\n", layout_session);
+
+	TAILQ_FOREACH(m, &monitor_q, entry) {
+		memset(&cur, 0, sizeof cur);
+		cur.name = (char *)m->name;
+		cur.edid = m->edid;
+		layout_fill(&cur, m);
+
+		layout_print(f, &cur);
+		free(cur.clients);
+	}
+
+	TAILQ_FOREACH(l, &layouts_q, entry) {
+		TAILQ_FOREACH(m, &monitor_q, entry) {
+			if (strcmp(m->name, l->name) == 0 &&
+			    (m->edid == 0 || l->edid == 0 || m->edid == l->edid))
+				break;
+		}
+		if (m == NULL)
+			layout_print(f, l);
+	}
+
+	if (fflush(f) != 0 || fsync(fileno(f)) != 0) {
+		log_msg("Couldn't write %s: %s", tmp, strerror(errno));
+		fclose(f);
+		unlink(tmp);
+	} else if (fclose(f) != 0) {
+		log_msg("Couldn't write %s: %s", tmp, strerror(errno));
+		unlink(tmp);
+	} else if (rename(tmp, layout_path) != 0) {
+		log_msg("Couldn't rename %s: %s", tmp, strerror(errno));
+		unlink(tmp);
+	}
+	free(tmp);
+}
@@ -28,23 +28,27 @@
 static void	 print_usage(void);
 static void	 set_display(const char *);
 static int	 check_for_existing_wm(void);
+static void	 startup_mark(const char *);
 
-char		*cfg_file = NULL;
+/* When startup began, and when the last stage of it finished. */
+static uint64_t	 startup_begin, startup_last;
 
-#define NO_OF_DESKTOPS 10
+char		*cfg_file = NULL;
 
 int main(int argc, char **argv)
 {
-	int			 opt, i;
+	int			 opt;
 	char			*display_opt = NULL;
+	char			*socket_path = NULL;
+	char			*layout_file = NULL;
 	xcb_screen_iterator_t	 iter;
 	struct monitor		*m;
 	struct passwd		*pw;
 	struct cmd_q		*cfg_cmd_q;
-	char			*name, *home, *causes;
+	char			*home, *causes;
 	u_int			 a;
 
-	while ((opt = getopt(argc, argv, "Vd:vf:")) != -1) {
+	while ((opt = getopt(argc, argv, "Vd:vf:l:s:")) != -1) {
 		switch (opt) {
 		/* Print the version and exit. */
 		case 'V':
@@ -61,6 +65,12 @@ int main(int argc, char **argv)
 		case 'f':
 			cfg_file = strdup(optarg);
 			break;
+		case 'l':
+			layout_file = strdup(optarg);
+			break;
+		case 's':
+			socket_path = strdup(optarg);
+			break;
 		default:
 			print_usage();
 			break;
@@ -105,6 +115,8 @@ int main(int argc, char **argv)
 		free(display_opt);
 	}
 
+	startup_begin = startup_last = event_now();
+
 	dpy = xcb_connect(NULL, &default_screen);
 	if (xcb_connection_has_error(dpy)) {
 		log_fatal("Couldn't open display '%s'\n", getenv("DISPLAY"));
@@ -123,22 +135,49 @@ int main(int argc, char **argv)
 	/* Check to see if another WM is running, and bail if it is. */
 	if (check_for_existing_wm() != 0)
 		log_fatal("There's already a WM running");
+	startup_mark("connect");
 
-	randr_maybe_init();
+	/* RandR needs atoms to read monitors' EDIDs. */
 	x_atoms_init();
+	startup_mark("atoms");
+	randr_maybe_init();
+	startup_mark("randr");
+	colour_cache_init();
+	startup_mark("colours");
 
-	TAILQ_FOREACH(m, &monitor_q, entry) {
-		for (i = 0; i < NO_OF_DESKTOPS; i++) {
-			xasprintf(&name, "%s:%d", m->name, i);
-			desktop_setup(m, name);
-			free(name);
-		}
-	}
+	/* Other desktops are only created when they're first used. */
+	TAILQ_FOREACH(m, &monitor_q, entry)
+		m->active_desktop = desktop_get(m, 0);
+	ewmh_set_active_window();
+	startup_mark("desktops");
 
 	TAILQ_INIT(&global_bindings);
+	keymap_update();
 	setup_bindings();
+	startup_mark("bindings");
+
+	if (socket_path == NULL)
+		socket_path = control_default_path();
+	if (socket_path != NULL)
+		control_init(socket_path);
+	free(socket_path);
 
 	client_scan_windows();
+#ifdef DEBUG
+	client_index_check();
+#endif
+	startup_mark("scan");
+
+	/* Put clients back where they were before a restart. */
+	if (layout_file != NULL) {
+		layout_load(layout_file);
+		free(layout_file);
+		TAILQ_FOREACH(m, &monitor_q, entry)
+			layout_restore(m);
+		startup_mark("layout");
+	}
+	log_msg("Startup took %llu us",
+	    (unsigned long long)(startup_last - startup_begin));
 
 	/* Go over all monitors, print the active desktop, and any clients
 	 * which are on them.
@@ -155,9 +194,12 @@ int main(int argc, char **argv)
 		}
 	}
 
-	xcb_flush(dpy);
-
 	event_loop();
+	rtt_summary(NULL);
+	pool_summary(NULL);
+	desktop_switch_summary(NULL);
+	layout_write();
+	control_close();
 	log_close();
 	xcb_disconnect(dpy);
 
@@ -199,13 +241,11 @@ check_for_existing_wm(void)
 	unsigned int		 values[1];
 	xcb_generic_error_t	*error;
 
-	values[0] = XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY |
-		    XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT;
+	values[0] = ROOT_EVENT_MASK;
 
-	error = xcb_request_check(dpy, xcb_change_window_attributes_checked(
-				dpy, current_screen->root, XCB_CW_EVENT_MASK,
-				values));
-	xcb_flush(dpy);
+	error = x_reply(xcb_request_check, dpy,
+	    xcb_change_window_attributes_checked(dpy, current_screen->root,
+		XCB_CW_EVENT_MASK, values));
 
 	return (error != NULL) ? 1 : 0;
 }
@@ -213,6 +253,18 @@ check_for_existing_wm(void)
 static void
 print_usage(void)
 {
-	fprintf(stderr, "%s [-Vv] [-d DISPLAY] [-f file]\n", PROGNAME);
+	fprintf(stderr, "%s [-Vv] [-d DISPLAY] [-f file] [-l layout-file] "
+	    "[-s socket]\n", PROGNAME);
 	exit(1);
 }
+
+/* Log how long the stage of startup which just finished took. */
+static void
+startup_mark(const char *stage)
+{
+	uint64_t	 now = event_now();
+
+	log_msg("Startup: %-10s %8llu us", stage,
+	    (unsigned long long)(now - startup_last));
+	startup_last = now;
+}
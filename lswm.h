@@ -71,20 +71,44 @@
 
 #define FOCUS_BORDER 0
 #define UNFOCUS_BORDER 1
+#define URGENT_BORDER 2
+#define NO_OF_BORDERS 3
+
+/* Events selected on the root window. */
+#define ROOT_EVENT_MASK (XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY |		\
+			 XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT |		\
+			 XCB_EVENT_MASK_COLOR_MAP_CHANGE)
 
 #define TYPE_KEY 0x1
 #define TYPE_MOUSE 0x2
 
-/* Parsed arguments structures. */
-struct args_entry {
-	u_char			 flag;
-	char			*value;
-	RB_ENTRY(args_entry)	 entry;
+/* Ways of hiding a client: unmapping it, or moving it off the screen. */
+#define HIDE_UNMAP 0
+#define HIDE_PARK 1
+
+/* Objects allocated from pools rather than one at a time. */
+enum pool_type {
+	POOL_CLIENT = 0,
+	POOL_BINDING,
+	POOL_CMD,
+	POOL_CMDQ_ITEM,
+	POOL_MAX
 };
-RB_HEAD(args_tree, args_entry);
+
+/*
+ * Parsed arguments structures.  Flags are a bitmap indexed by character;
+ * those with a value also take one of a few inline slots.  The values and
+ * argv strings are stored after the structure in the same allocation.
+ */
+#define ARGS_VALUES 4
 
 struct args {
-	struct args_tree	  tree;
+	u_char			  flags[256 / 8];
+
+	u_char			  value_flag[ARGS_VALUES];
+	char			 *value[ARGS_VALUES];
+	u_int			  nvalues;
+
 	int		 	  argc;
 	char	       		**argv;
 };
@@ -130,13 +154,22 @@ struct cmd_q {
 	time_t			 time;
 	u_int			 number;
 
+	/* Whether a command failed, and how many errors were shown. */
+	int			 failed;
+	u_int			 errors;
+
 	void			 (*emptyfn)(struct cmd_q *);
+	void			 (*printfn)(struct cmd_q *, const char *);
 	void			*data;
+
+	/* The client a binding was pressed in, if any. */
+	struct client		*client;
 };
 
 /* Command definition. */
 struct cmd_entry {
 	const char	*name;
+	const char	*alias;
 
 	const char	*args_template;
 	int		 args_lower;
@@ -148,11 +181,70 @@ struct cmd_entry {
 	enum cmd_retval	 (*exec)(struct cmd *, struct cmd_q *);
 };
 
+/* Time spent waiting on replies from one place in the code. */
+struct rtt_site {
+	const char		*name;
+	const char		*file;
+	int			 line;
+
+	u_int			 count;
+	u_int			 trips;
+	uint64_t		 total;
+	uint64_t		 max;
+
+	TAILQ_ENTRY(rtt_site)	 entry;
+};
+TAILQ_HEAD(rtt_sites, rtt_site);
+
+/* Wait for a reply with fn to the request with sequence number seq,
+ * accounting the time to this call site.
+ */
+#define x_reply_seq(seq, fn, ...) __extension__ ({			\
+	static struct rtt_site	 x_reply_site = {			\
+		#fn, __FILE__, __LINE__, 0, 0, 0, 0, { NULL, NULL }	\
+	};								\
+	int			 x_reply_trip = rtt_wait(seq);		\
+	uint64_t		 x_reply_start = event_now();		\
+	__typeof__(fn(__VA_ARGS__)) x_reply_r = fn(__VA_ARGS__);	\
+									\
+	rtt_record(&x_reply_site, x_reply_start, x_reply_trip);	\
+	x_reply_r;							\
+})
+
+/* As x_reply_seq(), for the usual case of a connection and a cookie. */
+#define x_reply(fn, c, ck, ...) __extension__ ({			\
+	__typeof__(ck)		 x_reply_ck = (ck);			\
+									\
+	x_reply_seq(x_reply_ck.sequence, fn, c, x_reply_ck,		\
+	    ##__VA_ARGS__);						\
+})
+
 struct x_atoms {
 	const char	*name;
 	xcb_atom_t	 atom;
 };
 
+/* Atoms which aren't initialised by the EWMH API.  Each becomes an entry
+ * in enum x_atom, and x_atom(NAME) is its value.
+ */
+#define X_ATOMS					\
+	X_ATOM(WM_PROTOCOLS)			\
+	X_ATOM(_MOTIF_WM_HINTS)			\
+	X_ATOM(WM_STATE)			\
+	X_ATOM(WM_CHANGE_STATE)			\
+	X_ATOM(WM_DELETE_WINDOW)		\
+	X_ATOM(WM_TAKE_FOCUS)			\
+	X_ATOM(EDID)				\
+	X_ATOM(_LSWM_SESSION)
+
+enum x_atom {
+#define X_ATOM(name) X_ATOM_##name,
+	X_ATOMS
+#undef X_ATOM
+	X_ATOM_MAX
+};
+#define x_atom(name) (cwmh_atoms[X_ATOM_##name].atom)
+
 struct rectangle {
 	int	 x;
 	int	 y;
@@ -167,9 +259,24 @@ struct geometry {
 	/* The window's border width */
 	int	 bw;
 
-	TAILQ_ENTRY(geometry)	 entry;
+	/* Maximised and so on are just another geometry. */
+	enum geometry_state {
+		NORMAL = 0,
+		MAXIMISED,
+		MAXIMISED_VERT,
+		MAXIMISED_HORIZ,
+		FULLSCREEN
+	} state;
+};
+
+/* Previous geometries of a client, newest last.  Once full, the oldest
+ * entry is overwritten.
+ */
+struct geometry_history {
+	struct geometry	 ring[CONFIG_GEOMETRY_HISTORY];
+	u_int		 head;
+	u_int		 len;
 };
-TAILQ_HEAD(geometries, geometry);
 
 struct client {
 	xcb_window_t	 	 win;
@@ -189,29 +296,50 @@ struct client {
 		int	 win_gravity;
 	} hints;
 
-	enum {
-		NORMAL = 0,
-		MAXIMISED,
-		MAXIMISED_VERT,
-		MAXIMISED_HORIZ,
-		FULLSCREEN
-	} state;
-
 #define CLIENT_INPUT_FOCUS	0x1
 #define CLIENT_URGENCY		0x2
 #define CLIENT_DELETE_WINDOW	0x4
+#define CLIENT_HIDDEN		0x8
+#define CLIENT_PARKED		0x10
 	int			 flags;
 
 	xcb_icccm_wm_hints_t	 xwmh;
 	xcb_icccm_get_wm_class_reply_t	 xch;
 
-	struct geometries	 geometries_q;
+	/* The current geometry. */
+	struct geometry		 geom;
+
+	/* Where it was before; for undo and to leave maximised, etc. */
+	struct geometry_history	 history;
+
+	/* The desktop this client is on. */
+	struct desktop		*desktop;
+
+	/* Entry in the window id index. */
+	LIST_ENTRY(client)	 index_entry;
 
 	TAILQ_ENTRY(client)	 entry;
 };
+LIST_HEAD(client_index_bucket, client);
 TAILQ_HEAD(clients, client);
 
+/* How clients of a given class are hidden, overriding their desktop. */
+struct hide_rule {
+	char			*class;
+	int			 hide;
+
+	TAILQ_ENTRY(hide_rule)	 entry;
+};
+TAILQ_HEAD(hide_rules, hide_rule);
+
 struct desktop {
+	/* Its number on its monitor, and the monitor. */
+	u_int			 idx;
+	struct monitor		*monitor;
+
+	/* How its clients are hidden, or -1 for the default. */
+	int			 hide;
+
 	/* The name of thie desktop. */
 	char			*name;
 
@@ -229,16 +357,38 @@ struct monitor {
 	struct rectangle	 size;
 	bool			 changed;
 
+	/* Whether RandR still reports this monitor. */
+	bool			 seen;
+
+	/* A hash of the EDID, to tell monitors on the same output apart. */
+	uint32_t		 edid;
+
 	/* The active desktop; the one currently displayed. */
 	struct desktop		*active_desktop;
 
-	/* The list of all desktops on this monitor. */
+	/* The list of all desktops on this monitor, in order, and the
+	 * same indexed by number.  Desktops not yet used are NULL.
+	 */
 	struct desktops		 desktops_q;
+	struct desktop		*desktops[CONFIG_DESKTOPS];
+	u_int			 ndesktops;
 
 	TAILQ_ENTRY(monitor)	 entry;
 };
 TAILQ_HEAD(monitors, monitor);
 
+/* Requests sent for a window ahead of managing it. */
+struct client_prefetch {
+	xcb_window_t			 win;
+	xcb_get_geometry_cookie_t	 geometry;
+	xcb_get_property_cookie_t	 wm_class;
+	xcb_get_property_cookie_t	 wm_hints;
+	xcb_get_property_cookie_t	 wm_protocols;
+	xcb_get_property_cookie_t	 wm_normal_hints;
+	xcb_get_property_cookie_t	 net_wm_name;
+	xcb_get_property_cookie_t	 wm_name;
+};
+
 /* Bindings for key/mouse. */
 union pressed {
 	xcb_keysym_t     key;
@@ -253,15 +403,49 @@ struct binding {
 
 	struct cmd_list			*cmd_list;
 
+	LIST_ENTRY(binding)		 index_entry;
 	TAILQ_ENTRY(binding)		 entry;
 };
 TAILQ_HEAD(bindings, binding);
+LIST_HEAD(binding_index_bucket, binding);
+
+/* A timer, run from the event loop once it expires. */
+struct timer {
+	uint64_t		 expiry;
+	void			(*cb)(void *);
+	void			*arg;
+
+	TAILQ_ENTRY(timer)	 entry;
+};
+TAILQ_HEAD(timers, timer);
+
+/* A descriptor polled by the event loop alongside the X connection. */
+struct event_fd {
+	int			 fd;
+	short			 events;
+	int			 idx;
+
+	void			(*cb)(struct event_fd *, short);
+	void			*arg;
+
+	TAILQ_ENTRY(event_fd)	 entry;
+};
+TAILQ_HEAD(event_fds, event_fd);
 
 struct monitors		 monitor_q;
 
 extern struct cmd_entry	*cmd_table[];
+#ifdef BENCH
+extern struct cmd_entry	 cmd_bench_parse;
+#endif
 extern struct cmd_entry	 cmd_bindm;
+extern struct cmd_entry	 cmd_hide_strategy;
+extern struct cmd_entry	 cmd_maximise;
 extern struct cmd_entry	 cmd_move;
+extern struct cmd_entry	 cmd_switch_desktop;
+extern struct cmd_entry	 cmd_show_pools;
+extern struct cmd_entry	 cmd_show_switch_times;
+extern struct cmd_entry	 cmd_show_round_trips;
 
 /* For failures of running commands during config loading. */
 extern struct causelist cfg_causes;
@@ -277,25 +461,39 @@ extern char		*cfg_file;
 struct bindings		 global_bindings;
 
 /* arguments.c */
-int		 args_cmp(struct args_entry *, struct args_entry *);
-RB_PROTOTYPE(args_tree, args_entry, entry, args_cmp);
+u_int		 args_template_values(const char *);
 struct args	*args_create(int, ...);
 struct args	*args_parse(const char *, int, char **);
 void		 args_free(struct args *);
 size_t		 args_print(struct args *, char *, size_t);
 int		 args_has(struct args *, u_char);
-void		 args_set(struct args *, u_char, const char *);
 const char	*args_get(struct args *, u_char);
 long long	 args_strtonum(
 		    struct args *, u_char, long long, long long, char **);
 
 /* events.c */
-void	 event_loop(void);
+void			 event_loop(void);
+uint64_t		 event_now(void);
+struct timer		*timer_add(u_int, void (*)(void *), void *);
+void			 timer_del(struct timer *);
+struct event_fd		*event_add_fd(int, short,
+			     void (*)(struct event_fd *, short), void *);
+void			 event_del_fd(struct event_fd *);
+
+/* control.c */
+char		*control_default_path(void);
+void		 control_init(const char *);
+void		 control_close(void);
 
 /* keys.c */
+void		 keymap_update(void);
+xcb_keysym_t	 keymap_keysym(xcb_keycode_t);
+u_int		 keymap_clean_mask(u_int);
+struct binding	*binding_find(u_int, u_int, u_int);
 void		 setup_bindings(void);
 void		 print_bindings(void);
 void		 grab_all_bindings(xcb_window_t);
+void		 regrab_all_bindings(void);
 
 /* log.c */
 void    log_file(void);
@@ -310,17 +508,52 @@ void	*xcalloc(size_t, size_t);
 int	 xsprintf(char *, const char *, ...);
 char	*xstrdup(const char *);
 void	*xrealloc(void *, size_t, size_t);
+void	*pool_get(enum pool_type);
+void	 pool_put(enum pool_type, void *);
+void	 pool_summary(struct cmd_q *);
+
+/* layout.c */
+void		 layout_save(struct monitor *);
+void		 layout_restore(struct monitor *);
+void		 layout_load(const char *);
+void		 layout_write(void);
+
+/* drag.c */
+#define DRAG_MOVE 0
+#define DRAG_RESIZE 1
+void		 drag_start(struct client *, int);
+void		 drag_motion(xcb_motion_notify_event_t *);
+void		 drag_end(void);
+void		 drag_cancel(struct client *);
+bool		 drag_active(void);
 
 /* randr.c */
 void		 randr_maybe_init(void);
 struct monitor	*monitor_at_xy(int, int);
+struct monitor	*monitor_nearest(int, int);
+void		 monitor_lookup_rebuild(void);
+void		 randr_handle_event(xcb_generic_event_t *);
 
 /* desktop.c */
-void		 desktop_setup(struct monitor *, const char *);
+struct desktop	*desktop_get(struct monitor *, u_int);
+struct desktop	*desktop_get_current(void);
+void		 desktop_set_current(struct desktop *);
+void		 desktop_show(struct monitor *, struct desktop *);
+void		 desktop_switch(struct monitor *, u_int);
+void		 desktop_switch_flushed(void);
+void		 desktop_switch_summary(struct cmd_q *);
 struct desktop	*desktop_create(void);
+void		 desktop_destroy(struct desktop *);
 void		 add_desktop_to_monitor(struct monitor *, struct desktop *);
 void		 desktop_set_name(struct desktop *, const char *);
-inline int	 desktop_count_all_desktops(void);
+u_int		 desktop_count_all_desktops(void);
+
+/* rtt.c */
+int		 rtt_wait(u_int);
+void		 rtt_record(struct rtt_site *, uint64_t, int);
+void		 rtt_op_begin(const char *);
+u_int		 rtt_op_end(void);
+void		 rtt_summary(struct cmd_q *);
 
 /* cfg.c */
 int		 load_cfg(const char *, struct cmd_q *, char **);
@@ -330,24 +563,50 @@ void		 cfg_show_causes(void);
 void	 	 client_scan_windows(void);
 struct client	*client_create(xcb_window_t);
 struct client	*client_find_by_window(xcb_window_t);
+void		 client_unmanage(struct client *);
+#ifdef DEBUG
+void		 client_index_check(void);
+#endif
 struct client	*client_get_current(void);
-void		 client_manage_client(struct client *, bool);
+void		 client_set_current(struct client *);
+void		 client_prefetch(struct client_prefetch *, xcb_window_t);
+void		 client_prefetch_discard(struct client_prefetch *);
+int		 client_manage_client(struct client *, struct client_prefetch *,
+		     bool);
 void		 client_set_bw(struct client *, struct geometry *);
+void		 client_apply_geometry(struct client *);
+void		 client_raise(struct client *);
+void		 client_move_to_desktop(struct client *, struct desktop *);
+void		 client_fit_to_monitor(struct client *, struct rectangle *,
+		     struct monitor *);
+void		 client_show(struct client *);
+void		 client_hide(struct client *);
+int		 client_hide_strategy(struct client *);
+void		 client_set_hide_rule(const char *, int);
+void		 client_set_hide_default(int);
+void		 client_push_geometry(struct client *);
+struct geometry	*client_peek_geometry(struct client *);
+int		 client_pop_geometry(struct client *, struct geometry *);
+int		 client_restore_geometry(struct client *);
 void		 client_set_border_colour(struct client *, int);
-uint32_t	 client_get_colour(const char *);
 void		 client_wm_hints(struct client *);
 void		 client_wm_protocols(struct client *);
 void		 client_mwm_hints(struct client *);
 void		 client_get_size_hints(struct client *);
 void		 client_set_name(struct client *);
 
+/* colour.c */
+void		 colour_cache_init(void);
+void		 colour_cache_invalidate(xcb_colormap_t);
+uint32_t	 colour_get_pixel(int);
+
 /* cmd.c */
-struct cmd_entry	*cmd_find_cmd(const char *);
+struct cmd_entry	*cmd_find_cmd(const char *, char **);
 char			**cmd_copy_argv(int, char *const *);
 void			cmd_free_argv(int, char **);
 size_t			cmd_print(struct cmd *, char *, size_t);
 struct cmd		*cmd_parse(int, char **, const char *, u_int, char **);
-void			*cmd_get_context(struct cmd *);
+void			*cmd_get_context(struct cmd *, struct cmd_q *);
 
 /* cmd-list.c */
 struct cmd_list	*cmd_list_parse(int, char **, const char *, u_int, char **);
@@ -362,6 +621,7 @@ int	 cmd_string_parse(const char *, struct cmd_list **, const char *,
 struct cmd_q		*cmdq_new(void);
 int			 cmdq_free(struct cmd_q *);
 void printflike2	 cmdq_error(struct cmd_q *, const char *, ...);
+void printflike2	 cmdq_print(struct cmd_q *, const char *, ...);
 void			 cmdq_run(struct cmd_q *, struct cmd_list *);
 void			 cmdq_append(struct cmd_q *, struct cmd_list *);
 int			 cmdq_continue(struct cmd_q *);
@@ -369,9 +629,20 @@ void			 cmdq_flush(struct cmd_q *);
 
 /* ewmh.c */
 xcb_ewmh_connection_t	*ewmh;
-xcb_atom_t	 x_atom_by_name(const char *);
+extern struct x_atoms	 cwmh_atoms[X_ATOM_MAX];
+enum x_atom	 x_atom_lookup(xcb_atom_t);
 void		 x_atoms_init(void);
 void		 ewmh_set_active_window(void);
 void		 ewmh_set_no_of_desktops(void);
+void		 ewmh_set_current_desktop(void);
+void		 ewmh_set_desktop_names(void);
+void		 ewmh_set_wm_desktop(struct client *);
+void		 ewmh_update_desktops(void);
+void		 ewmh_set_wm_state(struct client *);
+void		 ewmh_prop_forget(xcb_window_t);
+void		 ewmh_client_list_add(xcb_window_t);
+void		 ewmh_client_list_remove(xcb_window_t);
+void		 ewmh_client_list_raise(xcb_window_t);
+void		 ewmh_flush(void);
 
 #endif
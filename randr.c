@@ -22,23 +22,53 @@
 #include <xcb/randr.h>
 #include "lswm.h"
 
-static void randr_create_outputs(xcb_randr_output_t *, int, xcb_timestamp_t);
+static int		 randr_create_outputs(void);
+static int		 randr_create_monitors(void);
+static void		 randr_add_monitor(xcb_randr_output_t, struct rectangle,
+				const char *, uint32_t);
+static void		 randr_update(void *);
+static void		 randr_fit_clients(struct monitor *, struct rectangle *);
+static void		 randr_remove_monitor(struct monitor *, struct monitor *);
+static xcb_randr_get_output_property_cookie_t
+			 randr_edid_request(xcb_randr_output_t);
+static uint32_t		 randr_edid_hash(
+			     xcb_randr_get_output_property_cookie_t);
+
+/* Whether to use RandR 1.5 monitors rather than outputs. */
+static bool		 randr_use_monitors;
+
+/* Changes come in bursts; they're acted on once this goes off. */
+static struct timer	*randr_timer;
 static void		 monitor_create_randr_monitor(xcb_randr_output_t *,
-				struct rectangle, const char *);
+				struct rectangle, const char *, uint32_t);
 static struct monitor	*monitor_find_by_id(xcb_randr_output_t);
 static struct monitor	*monitor_find_by_name(const char *);
 static struct monitor	*monitor_find_duplicate(xcb_randr_output_t,
 				const char *);
+static int		 monitor_edge_cmp(const void *, const void *);
+static u_int		 monitor_edges_sort(int *, u_int);
+static int		 monitor_edge_find(int *, u_int, int);
+
+/* Monitors are found by position through a grid made from the edges of
+ * every monitor, so each cell lies wholly within one monitor or none.
+ */
+static struct {
+	int		*xs;
+	u_int		 nx;
+	int		*ys;
+	u_int		 ny;
+
+	/* (nx - 1) * (ny - 1) cells, a row at a time. */
+	struct monitor	**cells;
+} monitor_grid;
 
 void
 randr_maybe_init(void)
 {
-	struct rectangle				 size;
-	xcb_randr_get_screen_resources_current_reply_t	*res;
-	xcb_randr_output_t				*outputs;
-	xcb_randr_get_screen_resources_current_cookie_t	 res_ck;
-	const xcb_query_extension_reply_t		*ext;
-	int						 len;
+	struct rectangle			 size;
+	xcb_randr_query_version_reply_t		*ver;
+	const xcb_query_extension_reply_t	*ext;
+	int					 n;
 
 	/* Check to see if we have an RandR extension defined, and if not,
 	 * assume a single screen.  Note that not acquiring screen resource,
@@ -46,33 +76,38 @@ randr_maybe_init(void)
 	 * screen also.
 	 */
 	ext = xcb_get_extension_data(dpy, &xcb_randr_id);
-
-	res_ck = xcb_randr_get_screen_resources_current(dpy,
-			current_screen->root);
-	res = xcb_randr_get_screen_resources_current_reply(dpy, res_ck, NULL);
-
-	if (res == NULL || !ext->present)
-	{
+	if (ext == NULL || !ext->present) {
 		log_msg("No RANDR extension available.  "
 			"Falling back to single screen.");
-
 		goto single_screen;
 	}
 
-	len = xcb_randr_get_screen_resources_current_outputs_length(res);
-	outputs = xcb_randr_get_screen_resources_current_outputs(res);
+	ver = x_reply(xcb_randr_query_version_reply, dpy,
+	    xcb_randr_query_version(dpy, 1, 5), NULL);
+	if (ver == NULL) {
+		log_msg("RandR:  couldn't query version, using single screen.");
+		goto single_screen;
+	}
+	log_msg("RandR:  version %u.%u", ver->major_version,
+	    ver->minor_version);
 
-	log_msg("RandR:  found %d outputs", len);
+	/* RandR 1.5 can list monitors in one request. */
+	randr_use_monitors = CONFIG_RANDR_MONITORS &&
+	    (ver->major_version > 1 || ver->minor_version >= 5);
+	free(ver);
 
-	if (len > 0)
-		randr_create_outputs(outputs, len, res->config_timestamp);
-	free(res);
+	if (randr_use_monitors)
+		n = randr_create_monitors();
+	else
+		n = randr_create_outputs();
 
-	if (len == 0) {
+	if (n == 0) {
 		log_msg("RandR found with no screens, using single screen.");
 		goto single_screen;
 	}
 
+	monitor_lookup_rebuild();
+
 	/* If we end up here, then we should select for RandR events on the
 	 * root window and react accordingly.
 	 */
@@ -84,7 +119,6 @@ randr_maybe_init(void)
 			XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE |
 			XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE |
 			XCB_RANDR_NOTIFY_MASK_OUTPUT_PROPERTY);
-	xcb_flush(dpy);
 
 	return;
 
@@ -95,12 +129,195 @@ single_screen:
 	size.w = current_screen->width_in_pixels;
 	size.h = current_screen->height_in_pixels;
 
-	monitor_create_randr_monitor(NULL, size, "monitor");
+	monitor_create_randr_monitor(NULL, size, "monitor", 0);
+	monitor_lookup_rebuild();
+}
+
+/* Add or update a monitor for an output found by RandR.  If a known
+ * monitor has moved or changed size, its clients go with it.
+ */
+static void
+randr_add_monitor(xcb_randr_output_t id, struct rectangle size,
+		  const char *name, uint32_t edid)
+{
+	struct monitor		*m;
+	struct rectangle	 old;
+
+	if ((m = monitor_find_duplicate(id, name)) == NULL) {
+		monitor_create_randr_monitor(id == XCB_NONE ? NULL : &id, size,
+		    name, edid);
+		log_msg("RandR:  %s added", name);
+		return;
+	}
+	m->seen = true;
+
+	if (memcmp(&m->size, &size, sizeof size) == 0)
+		return;
+
+	old = m->size;
+	m->size = size;
+	m->changed = true;
+	log_msg("RandR:  %s changed from %dx%d+%d+%d", name, old.w, old.h,
+	    old.x, old.y);
+
+	randr_fit_clients(m, &old);
+}
+
+/* Keep the clients on a monitor in the same place relative to it. */
+static void
+randr_fit_clients(struct monitor *m, struct rectangle *old)
+{
+	struct desktop	*d;
+	struct client	*c;
+
+	TAILQ_FOREACH(d, &m->desktops_q, entry) {
+		TAILQ_FOREACH(c, &d->clients_q, entry)
+			client_fit_to_monitor(c, old, m);
+	}
+}
+
+/* A monitor has gone; move its desktops' clients to the same numbered
+ * desktops on another, and free it.
+ */
+static void
+randr_remove_monitor(struct monitor *m, struct monitor *to)
+{
+	struct desktop	*d, *d1, *to_d;
+	struct client	*c, *c1;
+
+	log_msg("RandR:  %s removed, moving clients to %s", m->name,
+	    to->name);
+	layout_save(m);
+
+	TAILQ_FOREACH_SAFE(d, &m->desktops_q, entry, d1) {
+		to_d = desktop_get(to, d->idx);
+		/* Fit first, so clients shown by the move appear in place. */
+		TAILQ_FOREACH_SAFE(c, &d->clients_q, entry, c1) {
+			client_fit_to_monitor(c, &m->size, to);
+			client_move_to_desktop(c, to_d);
+		}
+		desktop_destroy(d);
+	}
+
+	TAILQ_REMOVE(&monitor_q, m, entry);
+	free((char *)m->name);
+	free(m);
+}
+
+/* Ask for an output's EDID, to be hashed once the other replies are in.
+ * The cookie's sequence is 0 if there's nothing to ask.
+ */
+static xcb_randr_get_output_property_cookie_t
+randr_edid_request(xcb_randr_output_t id)
+{
+	xcb_randr_get_output_property_cookie_t	 ck = { 0 };
+
+	if (id == XCB_NONE || x_atom(EDID) == XCB_ATOM_NONE)
+		return (ck);
+	return (xcb_randr_get_output_property(dpy, id, x_atom(EDID),
+	    XCB_ATOM_ANY, 0, 128, 0, 0));
+}
+
+/* Hash an output's EDID (FNV-1a), or 0 if it doesn't have one. */
+static uint32_t
+randr_edid_hash(xcb_randr_get_output_property_cookie_t ck)
+{
+	xcb_randr_get_output_property_reply_t	*r;
+	uint8_t					*data;
+	uint32_t				 hash = 2166136261U;
+	int					 i, len;
+
+	if (ck.sequence == 0)
+		return (0);
+
+	r = x_reply(xcb_randr_get_output_property_reply, dpy, ck, NULL);
+	if (r == NULL)
+		return (0);
+
+	data = xcb_randr_get_output_property_data(r);
+	len = xcb_randr_get_output_property_data_length(r);
+	for (i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= 16777619U;
+	}
+	free(r);
+
+	return (len == 0 ? 0 : hash);
+}
+
+/* Something about the outputs has changed.  Wait for the rest of the burst
+ * of events before doing anything.
+ */
+void
+randr_handle_event(unused xcb_generic_event_t *ev)
+{
+	if (randr_timer != NULL)
+		timer_del(randr_timer);
+	randr_timer = timer_add(CONFIG_RANDR_DELAY, randr_update, NULL);
+}
+
+/* Ask RandR for the monitors again, and bring monitor_q into line: only
+ * monitors which have been added, removed or changed are touched, and
+ * everything is sent in one batch.  This waits on replies from a timer;
+ * event_loop() handles anything xcb queued in the meantime.
+ */
+static void
+randr_update(unused void *arg)
+{
+	struct monitor	*m, *m1, *to = NULL;
+	int		 n;
+
+	randr_timer = NULL;
+	rtt_op_begin("randr-update");
+
+	TAILQ_FOREACH(m, &monitor_q, entry) {
+		m->seen = false;
+		m->changed = false;
+	}
+
+	if (randr_use_monitors)
+		n = randr_create_monitors();
+	else
+		n = randr_create_outputs();
+
+	/* With nothing left (such as the lid being shut with no other
+	 * outputs), leave things as they are.
+	 */
+	if (n == 0) {
+		log_msg("RandR:  no active outputs, ignoring change");
+		TAILQ_FOREACH(m, &monitor_q, entry)
+			m->seen = true;
+		rtt_op_end();
+		return;
+	}
+
+	/* New monitors start on their first desktop. */
+	TAILQ_FOREACH(m, &monitor_q, entry) {
+		if (m->seen && m->active_desktop == NULL)
+			m->active_desktop = desktop_get(m, 0);
+		if (m->seen && to == NULL)
+			to = m;
+	}
+	TAILQ_FOREACH_SAFE(m, &monitor_q, entry, m1) {
+		if (!m->seen)
+			randr_remove_monitor(m, to);
+	}
+
+	/* Anything which was on a returning monitor goes back to it. */
+	TAILQ_FOREACH(m, &monitor_q, entry) {
+		if (m->changed)
+			layout_restore(m);
+	}
+
+	monitor_lookup_rebuild();
+	ewmh_update_desktops();
+
+	rtt_op_end();
 }
 
 static void
 monitor_create_randr_monitor(xcb_randr_output_t *id, struct rectangle info,
-			     const char *name)
+			     const char *name, uint32_t edid)
 {
 	struct monitor	*new;
 
@@ -110,8 +327,10 @@ monitor_create_randr_monitor(xcb_randr_output_t *id, struct rectangle info,
 	TAILQ_INIT(&new->desktops_q);
 
 	new->id = (id == NULL) ? XCB_NONE : *id;
+	new->edid = edid;
 	new->name = strdup(name);
-	new->changed = false;
+	new->changed = true;
+	new->seen = true;
 	memcpy(&new->size, &info, sizeof(struct rectangle));
 
 	if (TAILQ_EMPTY(&monitor_q))
@@ -120,85 +339,193 @@ monitor_create_randr_monitor(xcb_randr_output_t *id, struct rectangle info,
 		TAILQ_INSERT_TAIL(&monitor_q, new, entry);
 }
 
-/*
- * Walk through all the RANDR outputs (number of outputs == len) there
- * was at time timestamp.
+/* Create a monitor for every RandR 1.5 monitor, returning how many there
+ * are.  Monitors are named by atoms, so their names take a second trip,
+ * all requested together along with the EDIDs of their first outputs.
  */
-static void
-randr_create_outputs(xcb_randr_output_t *outputs, int len,
-		     xcb_timestamp_t timestamp)
+static int
+randr_create_monitors(void)
 {
+	xcb_randr_get_monitors_reply_t		*mr;
+	xcb_randr_monitor_info_iterator_t	 it;
+	xcb_get_atom_name_cookie_t		*name_ck;
+	xcb_get_atom_name_reply_t		*name_r;
+	xcb_randr_get_output_property_cookie_t	*edid_ck;
+	xcb_randr_output_t			 id;
 	struct rectangle			 size;
-	struct monitor				*m;
 	char					*name;
-	xcb_randr_get_crtc_info_cookie_t	 crtc_info_ck;
-	xcb_randr_get_crtc_info_reply_t		*crtc = NULL;
-	xcb_randr_get_output_info_reply_t	*output;
-	xcb_randr_get_output_info_cookie_t	 info_ck[len];
-	int					 i;
+	int					 i, n;
 
-	for (i = 0; i < len; i++)
-	{
-		info_ck[i] = xcb_randr_get_output_info(dpy, outputs[i],
-				timestamp);
+	mr = x_reply(xcb_randr_get_monitors_reply, dpy,
+	    xcb_randr_get_monitors(dpy, current_screen->root, 1), NULL);
+	if (mr == NULL)
+		return (0);
+
+	if ((n = mr->nMonitors) == 0) {
+		free(mr);
+		return (0);
 	}
+	log_msg("RandR:  found %d monitors", n);
+
+	name_ck = xcalloc(n, sizeof *name_ck);
+	edid_ck = xcalloc(n, sizeof *edid_ck);
+	it = xcb_randr_get_monitors_monitors_iterator(mr);
+	for (i = 0; i < n; i++) {
+		name_ck[i] = xcb_get_atom_name(dpy, it.data->name);
+
+		id = XCB_NONE;
+		if (xcb_randr_monitor_info_outputs_length(it.data) > 0)
+			id = xcb_randr_monitor_info_outputs(it.data)[0];
+		edid_ck[i] = randr_edid_request(id);
+
+		xcb_randr_monitor_info_next(&it);
+	}
+
+	it = xcb_randr_get_monitors_monitors_iterator(mr);
+	for (i = 0; i < n; i++) {
+		name_r = x_reply(xcb_get_atom_name_reply, dpy, name_ck[i],
+		    NULL);
+		if (name_r != NULL) {
+			xasprintf(&name, "%.*s",
+			    xcb_get_atom_name_name_length(name_r),
+			    xcb_get_atom_name_name(name_r));
+			free(name_r);
+		} else
+			xasprintf(&name, "monitor%d", i);
+
+		id = XCB_NONE;
+		if (xcb_randr_monitor_info_outputs_length(it.data) > 0)
+			id = xcb_randr_monitor_info_outputs(it.data)[0];
+
+		size.x = it.data->x;
+		size.y = it.data->y;
+		size.w = it.data->width;
+		size.h = it.data->height;
+
+		log_msg("RandR:  Monitor: %s at %d, %d, size: %dx%d", name,
+		    size.x, size.y, size.w, size.h);
+		randr_add_monitor(id, size, name, randr_edid_hash(edid_ck[i]));
+
+		free(name);
+		xcb_randr_monitor_info_next(&it);
+	}
+
+	free(edid_ck);
+	free(name_ck);
+	free(mr);
+
+	return (n);
+}
+
+/*
+ * Walk through all the RANDR outputs, creating a monitor for each which is
+ * active, and returning how many there are.  All the output information is
+ * asked for at once, and then all the CRTC information and EDIDs for
+ * active outputs.
+ */
+static int
+randr_create_outputs(void)
+{
+	xcb_randr_get_screen_resources_current_reply_t	*res;
+	xcb_randr_get_output_info_reply_t		**output;
+	xcb_randr_get_output_info_cookie_t		*info_ck;
+	xcb_randr_get_crtc_info_cookie_t		*crtc_ck;
+	xcb_randr_get_output_property_cookie_t		*edid_ck;
+	xcb_randr_get_crtc_info_reply_t			*crtc;
+	xcb_randr_output_t				*outputs;
+	xcb_timestamp_t					 timestamp;
+	struct rectangle				 size;
+	char						*name;
+	int						 i, len, n = 0;
+
+	res = x_reply(xcb_randr_get_screen_resources_current_reply, dpy,
+	    xcb_randr_get_screen_resources_current(dpy, current_screen->root),
+	    NULL);
+	if (res == NULL)
+		return (0);
+
+	len = xcb_randr_get_screen_resources_current_outputs_length(res);
+	outputs = xcb_randr_get_screen_resources_current_outputs(res);
+	timestamp = res->config_timestamp;
+
+	log_msg("RandR:  found %d outputs", len);
+	if (len == 0) {
+		free(res);
+		return (0);
+	}
+
+	info_ck = xcalloc(len, sizeof *info_ck);
+	crtc_ck = xcalloc(len, sizeof *crtc_ck);
+	edid_ck = xcalloc(len, sizeof *edid_ck);
+	output = xcalloc(len, sizeof *output);
 
-	/* Loop through all outputs. */
 	for (i = 0; i < len; i++)
-	{
-		output = xcb_randr_get_output_info_reply(dpy, info_ck[i], NULL);
+		info_ck[i] = xcb_randr_get_output_info(dpy, outputs[i],
+		    timestamp);
 
-		if (output == NULL)
+	/* Ask about the CRTC of every output which has one. */
+	for (i = 0; i < len; i++) {
+		output[i] = x_reply(xcb_randr_get_output_info_reply, dpy,
+		    info_ck[i], NULL);
+		if (output[i] == NULL)
 			continue;
 
 		/* If the output width/height is zero, then treat this output
 		 * as disabled, and move on to the next.
 		 */
-		if (output->mm_width == 0 && output->mm_height == 0)
+		if ((output[i]->mm_width == 0 && output[i]->mm_height == 0) ||
+		    output[i]->crtc == XCB_NONE) {
+			free(output[i]);
+			output[i] = NULL;
+			continue;
+		}
+		crtc_ck[i] = xcb_randr_get_crtc_info(dpy, output[i]->crtc,
+		    timestamp);
+		edid_ck[i] = randr_edid_request(outputs[i]);
+	}
+
+	for (i = 0; i < len; i++) {
+		if (output[i] == NULL)
 			continue;
 
 		xasprintf(&name, "%.*s",
-			xcb_randr_get_output_info_name_length(output),
-			xcb_randr_get_output_info_name(output));
+			xcb_randr_get_output_info_name_length(output[i]),
+			xcb_randr_get_output_info_name(output[i]));
 
 		log_msg("RandR:  Name: %s", name);
 		log_msg("RandR:  ID:   %d" , outputs[i]);
 		log_msg("RandR:  Size: %d x %d mm",
-			output->mm_width, output->mm_height);
-
-		if (output->crtc == XCB_NONE)
-			continue;
-
-		crtc_info_ck = xcb_randr_get_crtc_info(dpy, output->crtc,
-				timestamp);
-		crtc = xcb_randr_get_crtc_info_reply(dpy, crtc_info_ck,
-				NULL);
-		if (crtc == NULL)
-			return;
-
-		log_msg("RandR:  CRTC: at %d, %d, size: %dx%d",
-			crtc->x, crtc->y, crtc->width, crtc->height);
-
-		size.x = crtc->x;
-		size.y = crtc->y;
-		size.w = crtc->width;
-		size.h = crtc->height;
-
-		if ((m = monitor_find_duplicate(outputs[i], name)) == NULL)
-			monitor_create_randr_monitor(&outputs[i], size, name);
-		else {
-			m->size.x = size.x;
-			m->size.y = size.y;
-			m->size.w = size.w;
-			m->size.h = size.h;
-
-			m->changed = true;
-		}
+			output[i]->mm_width, output[i]->mm_height);
+
+		crtc = x_reply(xcb_randr_get_crtc_info_reply, dpy, crtc_ck[i],
+		    NULL);
+		if (crtc != NULL) {
+			log_msg("RandR:  CRTC: at %d, %d, size: %dx%d",
+				crtc->x, crtc->y, crtc->width, crtc->height);
+
+			size.x = crtc->x;
+			size.y = crtc->y;
+			size.w = crtc->width;
+			size.h = crtc->height;
+
+			randr_add_monitor(outputs[i], size, name,
+			    randr_edid_hash(edid_ck[i]));
+			n++;
+			free(crtc);
+		} else if (edid_ck[i].sequence != 0)
+			xcb_discard_reply(dpy, edid_ck[i].sequence);
 
 		free(name);
-		free(output);
+		free(output[i]);
 	}
 
+	free(output);
+	free(edid_ck);
+	free(crtc_ck);
+	free(info_ck);
+	free(res);
+
+	return (n);
 }
 
 static struct monitor *
@@ -214,23 +541,164 @@ monitor_find_by_id(xcb_randr_output_t id)
 	return (mon);
 }
 
+static int
+monitor_edge_cmp(const void *a, const void *b)
+{
+	int	 e1 = *(const int *)a, e2 = *(const int *)b;
+
+	return (e1 < e2 ? -1 : e1 > e2);
+}
+
+/* Sort edges and drop duplicates, returning how many are left. */
+static u_int
+monitor_edges_sort(int *edges, u_int n)
+{
+	u_int	 i, j;
+
+	if (n == 0)
+		return (0);
+	qsort(edges, n, sizeof *edges, monitor_edge_cmp);
+
+	for (i = 1, j = 1; i < n; i++) {
+		if (edges[i] != edges[j - 1])
+			edges[j++] = edges[i];
+	}
+	return (j);
+}
+
+/* Find i such that edges[i] <= v < edges[i + 1], or -1. */
+static int
+monitor_edge_find(int *edges, u_int n, int v)
+{
+	u_int	 lo = 0, hi = n, mid;
+
+	if (n < 2 || v < edges[0] || v >= edges[n - 1])
+		return (-1);
+
+	/* Find the first edge greater than v. */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (edges[mid] <= v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo - 1);
+}
+
+/* Build the grid used to find monitors by position.  Must be called
+ * whenever a monitor is added, removed or changes size.
+ */
+void
+monitor_lookup_rebuild(void)
+{
+	struct monitor	*m;
+	u_int		 n = 0, x, y, x0, x1, y0, y1, cols;
+
+	TAILQ_FOREACH(m, &monitor_q, entry)
+		n++;
+
+	free(monitor_grid.xs);
+	free(monitor_grid.ys);
+	free(monitor_grid.cells);
+	memset(&monitor_grid, 0, sizeof monitor_grid);
+	if (n == 0)
+		return;
+
+	monitor_grid.xs = xcalloc(2 * n, sizeof *monitor_grid.xs);
+	monitor_grid.ys = xcalloc(2 * n, sizeof *monitor_grid.ys);
+	TAILQ_FOREACH(m, &monitor_q, entry) {
+		monitor_grid.xs[monitor_grid.nx++] = m->size.x;
+		monitor_grid.xs[monitor_grid.nx++] = m->size.x + m->size.w;
+		monitor_grid.ys[monitor_grid.ny++] = m->size.y;
+		monitor_grid.ys[monitor_grid.ny++] = m->size.y + m->size.h;
+	}
+	monitor_grid.nx = monitor_edges_sort(monitor_grid.xs, monitor_grid.nx);
+	monitor_grid.ny = monitor_edges_sort(monitor_grid.ys, monitor_grid.ny);
+	if (monitor_grid.nx < 2 || monitor_grid.ny < 2)
+		return;
+
+	cols = monitor_grid.nx - 1;
+	monitor_grid.cells = xcalloc(cols * (monitor_grid.ny - 1),
+	    sizeof *monitor_grid.cells);
+
+	/* Where monitors overlap (such as when mirrored), the first wins. */
+	TAILQ_FOREACH(m, &monitor_q, entry) {
+		if (m->size.w <= 0 || m->size.h <= 0)
+			continue;
+		x0 = monitor_edge_find(monitor_grid.xs, monitor_grid.nx,
+		    m->size.x);
+		x1 = monitor_edge_find(monitor_grid.xs, monitor_grid.nx,
+		    m->size.x + m->size.w - 1);
+		y0 = monitor_edge_find(monitor_grid.ys, monitor_grid.ny,
+		    m->size.y);
+		y1 = monitor_edge_find(monitor_grid.ys, monitor_grid.ny,
+		    m->size.y + m->size.h - 1);
+
+		for (y = y0; y <= y1; y++) {
+			for (x = x0; x <= x1; x++) {
+				if (monitor_grid.cells[y * cols + x] == NULL)
+					monitor_grid.cells[y * cols + x] = m;
+			}
+		}
+	}
+	log_msg("Monitor grid is %ux%u cells", cols, monitor_grid.ny - 1);
+}
+
 /* Given x/y coordinates on a screen, find which monitor that position
- * is contained within.
+ * is contained within.  Each monitor covers from its x/y up to, but not
+ * including, x + w and y + h, so shared edges belong to just one.
  */
 struct monitor *
 monitor_at_xy(int x, int y)
 {
-	struct monitor		*m = NULL;
-	struct rectangle	 r;
+	int	 col, row;
 
-	TAILQ_FOREACH(m, &monitor_q, entry) {
-		r = m->size;
+	if (monitor_grid.cells == NULL)
+		return (NULL);
 
-		if ((x >= r.x && x <= r.x + r.w) &&
-		    (y >= r.y && y <= r.y + r.h))
-			break;
+	col = monitor_edge_find(monitor_grid.xs, monitor_grid.nx, x);
+	row = monitor_edge_find(monitor_grid.ys, monitor_grid.ny, y);
+	if (col == -1 || row == -1)
+		return (NULL);
+
+	return (monitor_grid.cells[row * (monitor_grid.nx - 1) + col]);
+}
+
+/* As monitor_at_xy(), but for a position not on any monitor, such as in
+ * the gap beside a smaller one, find the closest.
+ */
+struct monitor *
+monitor_nearest(int x, int y)
+{
+	struct monitor		*m, *best = NULL;
+	struct rectangle	*r;
+	long long		 dx, dy, d, best_d = 0;
+
+	if ((m = monitor_at_xy(x, y)) != NULL)
+		return (m);
+
+	TAILQ_FOREACH(m, &monitor_q, entry) {
+		r = &m->size;
+
+		dx = 0;
+		if (x < r->x)
+			dx = r->x - x;
+		else if (x >= r->x + r->w)
+			dx = x - (r->x + r->w - 1);
+		dy = 0;
+		if (y < r->y)
+			dy = r->y - y;
+		else if (y >= r->y + r->h)
+			dy = y - (r->y + r->h - 1);
+
+		d = dx * dx + dy * dy;
+		if (best == NULL || d < best_d) {
+			best = m;
+			best_d = d;
+		}
 	}
-	return (m);
+	return (best);
 }
 
 static struct monitor *
@@ -246,24 +714,18 @@ monitor_find_by_name(const char *name)
 	return (mon);
 }
 
+/* Find a monitor we already know about: by output, or failing that (such
+ * as for RandR 1.5 monitors without outputs), by name.
+ */
 static struct monitor *
 monitor_find_duplicate(xcb_randr_output_t id, const char *name)
 {
-	struct monitor	*m2, *m_find;
-
-	TAILQ_FOREACH(m2, &monitor_q, entry) {
-		if (m2 == NULL)
-			continue;
-
-		if ((m_find = monitor_find_by_id(id)) == NULL ||
-		    ((m_find = monitor_find_by_name(name)) == NULL))
-				continue;
+	struct monitor	*m = NULL;
 
-		log_msg("Found a duplicate: %s -> %s", m2->name,
-			m_find->name);
+	if (id != XCB_NONE)
+		m = monitor_find_by_id(id);
+	if (m == NULL)
+		m = monitor_find_by_name(name);
 
-		return (m2);
-	}
-
-	return (NULL);
+	return (m);
 }
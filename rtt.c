@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2013 Thomas Adam <thomas@xteddy.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Accounting for time spent waiting on the X server.
+ *
+ * Every reply is collected through x_reply(), which gives each call site
+ * its own struct rtt_site recording how often it waited and for how
+ * long.  Operations such as managing a window can also be bracketed with
+ * rtt_op_begin() and rtt_op_end() to log how many round trips they needed.
+ *
+ * Not every reply is a round trip: a reply to a request sent before the
+ * last round trip started will have come back along with it.
+ */
+
+#include <string.h>
+#include "lswm.h"
+
+static struct rtt_sites	 rtt_sites_q = TAILQ_HEAD_INITIALIZER(rtt_sites_q);
+
+/* The last request sent when the latest round trip started. */
+static u_int		 rtt_horizon;
+
+static struct {
+	const char	*name;
+	uint64_t	 start;
+	u_int		 count;
+	u_int		 trips;
+	uint64_t	 waited;
+} rtt_op;
+
+/* Return whether waiting for the reply to request seq is a round trip.  If
+ * it is, everything sent so far goes out with it, so find out how far
+ * that is; this costs a request, but only when about to wait anyway.
+ */
+int
+rtt_wait(u_int seq)
+{
+	if (rtt_horizon != 0 && (int)(seq - rtt_horizon) < 0)
+		return (0);
+
+	rtt_horizon = xcb_no_operation(dpy).sequence;
+	return (1);
+}
+
+void
+rtt_record(struct rtt_site *site, uint64_t start, int trip)
+{
+	uint64_t	 waited;
+
+	waited = event_now() - start;
+
+	if (site->count++ == 0)
+		TAILQ_INSERT_TAIL(&rtt_sites_q, site, entry);
+	site->trips += trip;
+	site->total += waited;
+	if (waited > site->max)
+		site->max = waited;
+
+	if (rtt_op.name != NULL) {
+		rtt_op.count++;
+		rtt_op.trips += trip;
+		rtt_op.waited += waited;
+	}
+}
+
+void
+rtt_op_begin(const char *name)
+{
+	rtt_op.name = name;
+	rtt_op.start = event_now();
+	rtt_op.count = 0;
+	rtt_op.trips = 0;
+	rtt_op.waited = 0;
+}
+
+/* Log the round trips made since rtt_op_begin(), returning how many. */
+u_int
+rtt_op_end(void)
+{
+	u_int	 trips = rtt_op.trips;
+
+	if (rtt_op.name == NULL)
+		return (0);
+
+	log_msg("%s: %u round trip(s) for %u replies, %llu us waiting, "
+	    "%llu us total", rtt_op.name, rtt_op.trips, rtt_op.count,
+	    (unsigned long long)rtt_op.waited,
+	    (unsigned long long)(event_now() - rtt_op.start));
+
+	rtt_op.name = NULL;
+	return (trips);
+}
+
+/* Print a line per call site.  Without a command queue, print to the log. */
+void
+rtt_summary(struct cmd_q *cmdq)
+{
+	struct rtt_site	*site;
+
+	cmdq_print(cmdq, "%-40s %-16s %8s %8s %10s %8s", "request", "site",
+	    "trips", "replies", "total us", "max us");
+
+	TAILQ_FOREACH(site, &rtt_sites_q, entry) {
+		cmdq_print(cmdq, "%-40s %-12s:%-3d %8u %8u %10llu %8llu",
+		    site->name, site->file, site->line, site->trips,
+		    site->count, (unsigned long long)site->total,
+		    (unsigned long long)site->max);
+	}
+}
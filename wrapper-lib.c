@@ -120,3 +120,103 @@ xrealloc(void *oldptr, size_t nmemb, size_t size)
 
 	return (newptr);
 }
+
+/* Objects which come and go often are carved from slabs of POOL_SLAB
+ * objects, and kept on a free list when released, rather than going back
+ * to malloc() each time.  Slabs are never returned.
+ */
+#define POOL_SLAB 32
+
+struct pool_object {
+	struct pool_object	*next;
+};
+
+static struct pool {
+	const char		*name;
+	size_t			 size;
+
+	struct pool_object	*free;
+	u_int			 nfree;
+	u_int			 live;
+	u_int			 peak;
+	u_int			 slabs;
+} pools[POOL_MAX] = {
+	{ "client", sizeof (struct client), NULL, 0, 0, 0, 0 },
+	{ "binding", sizeof (struct binding), NULL, 0, 0, 0, 0 },
+	{ "cmd", sizeof (struct cmd), NULL, 0, 0, 0, 0 },
+	{ "cmd_q_item", sizeof (struct cmd_q_item), NULL, 0, 0, 0, 0 },
+};
+
+static void
+pool_grow(struct pool *p)
+{
+	struct pool_object	*obj;
+	size_t			 size;
+	char			*slab;
+	u_int			 i;
+
+	/* Keep every object suitably aligned for anything. */
+	size = MAX(p->size, sizeof *obj);
+	size = roundup(size, sizeof (long double));
+
+	slab = xcalloc(POOL_SLAB, size);
+	for (i = 0; i < POOL_SLAB; i++) {
+		obj = (struct pool_object *)(slab + i * size);
+		obj->next = p->free;
+		p->free = obj;
+	}
+	p->nfree += POOL_SLAB;
+	p->slabs++;
+}
+
+/* Get a zeroed object from a pool. */
+void *
+pool_get(enum pool_type type)
+{
+	struct pool		*p = &pools[type];
+	struct pool_object	*obj;
+
+	if (p->free == NULL)
+		pool_grow(p);
+
+	obj = p->free;
+	p->free = obj->next;
+	p->nfree--;
+
+	if (++p->live > p->peak)
+		p->peak = p->live;
+
+	memset(obj, 0, p->size);
+	return (obj);
+}
+
+void
+pool_put(enum pool_type type, void *ptr)
+{
+	struct pool		*p = &pools[type];
+	struct pool_object	*obj = ptr;
+
+	if (ptr == NULL)
+		return;
+	if (p->live == 0)
+		log_fatal("Freeing %s with none in use", p->name);
+
+	obj->next = p->free;
+	p->free = obj;
+	p->nfree++;
+	p->live--;
+}
+
+void
+pool_summary(struct cmd_q *cmdq)
+{
+	struct pool	*p;
+
+	cmdq_print(cmdq, "%-12s %6s %8s %8s %8s %6s", "pool", "size", "live",
+	    "peak", "free", "slabs");
+
+	for (p = pools; p < pools + POOL_MAX; p++) {
+		cmdq_print(cmdq, "%-12s %6zu %8u %8u %8u %6u", p->name,
+		    p->size, p->live, p->peak, p->nfree, p->slabs);
+	}
+}